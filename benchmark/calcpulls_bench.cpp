@@ -0,0 +1,228 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <mpir.h>
+
+#include "../calcpulls.h"
+
+// ---- #
+// Benchmark of every phase of the calculations.
+// Runs the full calculation (characters, weapons, pairs, output and cleaning) for each scalar policy and thread count,
+// --- a number of times each, timing every phase through "GNSN_PhaseObserver", and writes the timings as JSON.
+//
+// Usage: calcpulls_bench [--scalars mpf,fixed256,double,longdouble,float128] [--threads 1,2,4] [--repeat 5] [--digits 24] [--kernel scalar|avx2|avx512] [--no-output] [--json file]
+// A thread count of 0 means one per hardware thread.
+// "--digits" picks the precision from the output digits ("SetAdaptivePrecision()") instead of the fixed 256 bits.
+// "--kernel" caps the convolution kernels of the double policy (see "calcpulls_kernels.h") below the best the CPU has.
+// The output phases write their usual files to the working directory.
+// ---- #
+
+typedef std::chrono::steady_clock BenchClock;
+
+struct BenchOptions
+{
+  std::vector<std::string> scalars = { "mpf", "double" };
+  std::vector<int> threads = { 1 };
+  int repeat = 5;
+  int digits = 0;
+  bool output = true;
+  std::string json;
+};
+
+// Every timing of each phase of one scalar policy and thread count, in seconds.
+struct BenchResult
+{
+  std::string scalar;
+  int threads = 1;
+  unsigned long precision = 0;
+  std::vector<std::string> order; // Phases in the order they first ran.
+  std::map<std::string, std::vector<double>> seconds;
+
+  void Add(const std::string& phase, double value)
+  {
+    if(seconds.find(phase) == seconds.end())
+      order.push_back(phase);
+    seconds[phase].push_back(value);
+  }
+};
+
+static std::vector<std::string> SplitList(const char* text)
+{
+  std::vector<std::string> items;
+  std::stringstream ss(text);
+  std::string item;
+  while(std::getline(ss, item, ','))
+  {
+    if(!item.empty())
+      items.push_back(item);
+  }
+  return items;
+}
+
+template<class TScalar>
+static BenchResult RunBench(const BenchOptions& options, int threads)
+{
+  BenchResult result;
+  result.scalar = TScalar::Name();
+  result.threads = threads;
+
+  std::map<std::string, BenchClock::time_point> started;
+  for(int run = 0; run < options.repeat; run++)
+  {
+    // A phase can run several times in one run (once per level), so its times are summed per run.
+    std::vector<std::string> runOrder;
+    std::map<std::string, double> runSeconds;
+
+    GNSN_WProbCalcT<TScalar> calc;
+    calc.SetThreadCount(threads);
+    if(options.digits > 0)
+      calc.SetAdaptivePrecision(options.digits);
+    result.threads = calc.GetThreadCount();
+    result.precision = calc.GetPrecision();
+    calc.SetPhaseObserver([&](const char* phase, bool starting) {
+      if(starting)
+      {
+        started[phase] = BenchClock::now();
+        return;
+      }
+      if(runSeconds.find(phase) == runSeconds.end())
+        runOrder.push_back(phase);
+      runSeconds[phase] += std::chrono::duration<double>(BenchClock::now() - started[phase]).count();
+    });
+
+    BenchClock::time_point start = BenchClock::now();
+    calc.CalcSSRPair();
+    const double calcSeconds = std::chrono::duration<double>(BenchClock::now() - start).count();
+    if(options.output)
+    {
+      calc.OutputDebug();
+      calc.OutputResults();
+    }
+    calc.Clean();
+
+    // The destructor cleans again, which isn't part of the run.
+    calc.SetPhaseObserver(nullptr);
+
+    for(const std::string& phase : runOrder)
+      result.Add(phase, runSeconds[phase]);
+    result.Add("calc.total", calcSeconds);
+  }
+  return result;
+}
+
+static void WriteJSON(std::ostream& os, const BenchOptions& options, const std::vector<BenchResult>& results)
+{
+  os << "{\n";
+  os << "  \"benchmark\": \"calcpulls\",\n";
+  os << "  \"repeat\": " << options.repeat << ",\n";
+  os << "  \"hardwareThreads\": " << GNSN_ThreadPool::HardwareThreads() << ",\n";
+  os << "  \"doubleKernel\": \"" << GNSN_DoubleKernels::GetLevelName(GNSN_DoubleKernels::GetLevel()) << "\",\n";
+  os << "  \"runs\": [";
+  for(size_t index = 0; index < results.size(); index++)
+  {
+    const BenchResult& result = results[index];
+    os << (index == 0 ? "\n" : ",\n");
+    os << "    {\n";
+    os << "      \"scalar\": \"" << result.scalar << "\",\n";
+    os << "      \"threads\": " << result.threads << ",\n";
+    os << "      \"precision\": " << result.precision << ",\n";
+    os << "      \"phases\": {";
+    for(size_t phase = 0; phase < result.order.size(); phase++)
+    {
+      std::vector<double> values = result.seconds.at(result.order[phase]);
+      std::sort(values.begin(), values.end());
+      double sum = 0.0;
+      for(double value : values)
+        sum += value;
+      os << (phase == 0 ? "\n" : ",\n");
+      os << "        \"" << result.order[phase] << "\": { "
+        << "\"min\": " << values.front() << ", "
+        << "\"median\": " << values[values.size() / 2] << ", "
+        << "\"mean\": " << sum / values.size() << ", "
+        << "\"max\": " << values.back() << " }";
+    }
+    os << "\n      }\n";
+    os << "    }";
+  }
+  os << "\n  ]\n";
+  os << "}\n";
+}
+
+int main(int argc, char** argv)
+{
+  BenchOptions options;
+  for(int arg = 1; arg < argc; arg++)
+  {
+    const bool hasValue = arg + 1 < argc;
+    if(std::strcmp(argv[arg], "--scalars") == 0 && hasValue)
+      options.scalars = SplitList(argv[++arg]);
+    else if(std::strcmp(argv[arg], "--threads") == 0 && hasValue)
+    {
+      options.threads.clear();
+      for(const std::string& item : SplitList(argv[++arg]))
+        options.threads.push_back(std::atoi(item.c_str()));
+    }
+    else if(std::strcmp(argv[arg], "--repeat") == 0 && hasValue)
+      options.repeat = std::max(1, std::atoi(argv[++arg]));
+    else if(std::strcmp(argv[arg], "--digits") == 0 && hasValue)
+      options.digits = std::max(0, std::atoi(argv[++arg]));
+    else if(std::strcmp(argv[arg], "--kernel") == 0 && hasValue)
+    {
+      const std::string kernel = argv[++arg];
+      GNSN_DoubleKernels::SetLevel(kernel == "scalar" ? GNSN_DoubleKernels::kScalar
+        : kernel == "avx2" ? GNSN_DoubleKernels::kAVX2 : GNSN_DoubleKernels::kAVX512);
+    }
+    else if(std::strcmp(argv[arg], "--no-output") == 0)
+      options.output = false;
+    else if(std::strcmp(argv[arg], "--json") == 0 && hasValue)
+      options.json = argv[++arg];
+    else
+    {
+      std::cerr << "Usage: " << argv[0] << " [--scalars mpf,fixed256,double,longdouble,float128] [--threads 1,2,4] [--repeat 5] [--digits 24] [--kernel scalar|avx2|avx512] [--no-output] [--json file]\n";
+      return 1;
+    }
+  }
+
+  std::vector<BenchResult> results;
+  for(const std::string& scalar : options.scalars)
+  {
+    for(int threads : options.threads)
+    {
+      if(scalar == "mpf")
+        results.push_back(RunBench<GNSN_ScalarMPF>(options, threads));
+      else if(scalar == "fixed256")
+        results.push_back(RunBench<GNSN_ScalarFixed256>(options, threads));
+      else if(scalar == "double")
+        results.push_back(RunBench<GNSN_ScalarDouble>(options, threads));
+      else if(scalar == "longdouble")
+        results.push_back(RunBench<GNSN_ScalarLongDouble>(options, threads));
+#ifdef GNSN_WPROBCALC_HAS_FLOAT128
+      else if(scalar == "float128")
+        results.push_back(RunBench<GNSN_ScalarFloat128>(options, threads));
+#endif
+      else
+      {
+        std::cerr << "Unknown scalar policy \"" << scalar << "\".\n";
+        return 1;
+      }
+    }
+  }
+
+  if(options.json.empty())
+  {
+    WriteJSON(std::cout, options, results);
+  }
+  else
+  {
+    std::ofstream ofs(options.json, std::ofstream::out | std::ofstream::trunc);
+    WriteJSON(ofs, options, results);
+  }
+  return 0;
+}
@@ -1,19 +1,151 @@
 #pragma once
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
 #include <mpir.h>
+#include "calcpulls_arena.h"
+#include "calcpulls_binary.h"
+#include "calcpulls_convolve.h"
+#include "calcpulls_rules.h"
+#include "calcpulls_scalar.h"
+#include "calcpulls_stats.h"
+#include "calcpulls_threadpool.h"
 
-class GNSN_WProbCalc
+// The state of a banner before pulling, which is all the next pulls depend on.
+struct GNSN_PullState
 {
+  int pity = 0;            // Pulls done since the last five-star.
+  bool guaranteed = false; // The next five-star is a featured one (the last 50/50 was lost, or for weapons, the last five-star was a standard one).
+  int fatePoints = 0;      // Weapon banner only: points on the epitomized path, where the rules' "fatePoints" make the next five-star the specific one.
+};
+
+// The part of a table that isn't zero, as indices (pull count - 1).
+struct GNSN_TableSupport
+{
+  int lo = 0;              // First nonzero value.
+  int hi = -1;             // Last nonzero value, below "lo" when the whole table is zero.
+  double discarded = 0.0;  // Probability taken out of the table by the error budget, in it and in the tables it was made from.
+
+  bool IsEmpty() const { return hi < lo; }
+  int GetCount() const { return hi < lo ? 0 : hi - lo + 1; }
+};
+
+// Called when each part ("phase") of a calculation starts and ends, for timing them from outside.
+// Phases are named after what they calculate, like "character.source", "weapon.duplicates" or "pair.cells".
+typedef std::function<void(const char* phase, bool starting)> GNSN_PhaseObserver;
+
+// An array of probabilities per pull count, stored as "pull count - 1" like the tables of "GNSN_WProbCalcT".
+template<class TScalar>
+class GNSN_ProbArrayT
+{
+public:
+  typedef typename TScalar::Value Value;
+
+private:
+  GNSN_Arena arena;
+  Value* values = nullptr;
+  int count = 0;
+
+public:
+  // Drop the old values and make room for "count" values set to 0, with "precision" bits (see "TScalar::InitArray()").
+  void Reset(int count, unsigned long precision)
+  {
+    this->arena.Release();
+    this->values = this->arena.AllocateArray<Value>(count);
+    this->count = count;
+    TScalar::InitArray(this->values, count, precision, this->arena);
+  }
+
+  int GetCount() const { return count; }
+  Value* GetValues() { return values; }
+  const Value* GetValues() const { return values; }
+  Value& operator[](int index) { return values[index]; }
+  const Value& operator[](int index) const { return values[index]; }
+};
+
+// "TScalar" is one of the scalar policies from "calcpulls_scalar.h".
+// Every table stores "TScalar::Value"s, so the same calculations can run with MPF or with native floats.
+template<class TScalar>
+class GNSN_WProbCalcT
+{
+public:
+  typedef TScalar Scalar;
+  typedef typename TScalar::Value Value;
+
 private:
   int initialized = 0;
 
+  // Levels and cells calculated so far, one bit each, for when they are calculated on their own (see "GetSSRPairTable()").
+  // "initialized" only gets set once all of them are there.
+  int levelsSSRChar = 0;
+  int levelsSSRWeap = 0;
+  uint64_t cellsSSRPair = 0; // Bit "conLevel * 5 + refLevel".
+
+  // Source tables there now, 1 for the character banner and 2 for the weapon banner.
+  // They only take the pity rules, so they can outlive the rest of the banner's tables (see "SetBannerRules()").
+  int sourcesSSR = 0;
+
+  // The banners the tables are for, see "SetBannerRules()".
+  GNSN_BannerRules rules = GNSN_GenshinRules;
+
+  // Bits the MPF tables are calculated with, and decimals the outputs print, see "SetAdaptivePrecision()".
+  unsigned long precision = 256;
+  int outputDigits = 24;
+
+  // Probability each table may drop from its tails, see "SetErrorBudget()".
+  double errorBudget = 0.0;
+
+  // Threads for the independent parts of the calculations, where 1 keeps everything on the calling thread.
+  int threadCount = 1;
+  std::unique_ptr<GNSN_ThreadPool> threadPool;
+
+  // Memory for the tables of characters, weapons and pairs.
+  GNSN_Arena arenaSSRChar;
+  GNSN_Arena arenaSSRWeap;
+  GNSN_Arena arenaSSRPair;
+
+  // Memory for the source tables of characters and weapons ("ProbSrc..." and "ProbSrcDist...").
+  GNSN_Arena arenaSrcSSRChar;
+  GNSN_Arena arenaSrcSSRWeap;
+
+  // Transforms of the character and weapon tables, which every pair cell of the level convolves with again.
+  // They go with the tables of their banner, so a pair cell calculated again after the other banner's rules changed
+  // --- (see "SetBannerRules()") only transforms the table of the banner that changed.
+  GNSN_SpectrumCache<TScalar> spectraSSRChar;
+  GNSN_SpectrumCache<TScalar> spectraSSRWeap;
+
+  // Told about the phases of the calculations, if set.
+  GNSN_PhaseObserver phaseObserver;
+
+#ifdef GNSN_WPROBCALC_STATS
+  // Statistics, see "calcpulls_stats.h".
+  struct OpenPhase
+  {
+    const char* name;
+    std::chrono::steady_clock::time_point start;
+    GNSN_OpCounts ops;
+  };
+
+  GNSN_CalcStats stats;
+  std::vector<OpenPhase> openPhases;
+  GNSN_OpCounters opCounters;               // This calculator's operations, see "GNSN_OpCounters".
+  GNSN_OpCounters* countersBefore = nullptr; // What the calling thread counted into before the first open phase.
+#endif
+
+  // A table file the tables point into, after "LoadTables()".
+  std::unique_ptr<GNSN_MappedFile> mappedTables;
+
 private:
   // ---- #
   // Source probability for acqusition of any SSR per pull count.
   // These should store the probability to acquire a five-star when landing on a specific pull count.
+  // Each has one value per pull count up to hard pity.
   // ---- #
 
-  mpf_t ProbSrc_SSRChar[90];
-  mpf_t ProbSrc_SSRWeap[80];
+  Value* ProbSrc_SSRChar;
+  Value* ProbSrc_SSRWeap;
 
 
 
@@ -22,8 +154,8 @@ private:
   // These should store the probabilities for which pull count a five-star could occur on.
   // ---- #
 
-  mpf_t ProbSrcDist_SSRChar[90];
-  mpf_t ProbSrcDist_SSRWeap[80];
+  Value* ProbSrcDist_SSRChar;
+  Value* ProbSrcDist_SSRWeap;
 
 
 
@@ -32,15 +164,36 @@ private:
   // ---- #
 
   // A pointer to memory for the probabilities for seven copies,
-  // --- each copy needing at most 180 pulls more than the last.
-  mpf_t* ProbPL_SSRChar[7];
+  // --- each copy needing at most the character stride (180 pulls) more than the last, see "GNSN_CharacterRules::GetStride()".
+  Value* ProbPL_SSRChar[7];
 
   // A pointer to memory for the probabilities for five refinements,
-  // --- each copy needing 240 pulls more than the last.
-  mpf_t* ProbPL_SSRWeap[5];
+  // --- each copy needing at most the weapon stride (240 pulls) more than the last.
+  Value* ProbPL_SSRWeap[5];
 
   // A pointer to memory for the probabilities for each variation of duplicate levels for character and weapons.
-  mpf_t* ProbPL_SSRPair[7][5]; 
+  Value* ProbPL_SSRPair[7][5];
+
+
+
+  // ---- #
+  // Cumulative probability per level of an SSR per pull count.
+  // The same layout as the tables above, where each entry is the probability to have the level by that pull count.
+  // ---- #
+
+  Value* ProbCDF_SSRChar[7];
+  Value* ProbCDF_SSRWeap[5];
+  Value* ProbCDF_SSRPair[7][5];
+
+
+
+  // ---- #
+  // Support of each table per level, so the convolutions only go over the part that isn't zero.
+  // ---- #
+
+  GNSN_TableSupport Support_SSRChar[7];
+  GNSN_TableSupport Support_SSRWeap[5];
+  GNSN_TableSupport Support_SSRPair[7][5];
 
 
 
@@ -55,11 +208,251 @@ public:
   void OutputResults();
   void Clean();
 
+  // ---- #
+  // Single tables, indexed by pull count - 1, or null for a level out of range.
+  // Only what the table depends on gets calculated: a level needs the levels below it,
+  // --- and a pair cell needs its character level and weapon level, not the whole grid.
+  // Everything calculated is kept for later calls, and for "CalcSSR...()", until "Clean()".
+  // ---- #
+
+  const Value* GetSSRCharacterTable(int conLevel);
+  const Value* GetSSRWeaponTable(int refLevel);
+  const Value* GetSSRPairTable(int conLevel, int refLevel);
+
+  // ---- #
+  // Support of the tables and the error budget.
+  // Every table keeps track of the range of pull counts where it isn't zero, and convolutions only go over that range.
+  // With an error budget above 0, each table also drops up to that much probability from its tails (half from each end),
+  // --- so convolutions get shorter still. The "discarded" of a table's support bounds the probability it's missing because of that.
+  // Changing the budget cleans the calculator, since the tables depend on it.
+  // ---- #
+
+  void SetErrorBudget(double epsilon);
+  double GetErrorBudget() const { return errorBudget; }
+  GNSN_TableSupport GetSSRCharacterSupport(int conLevel);
+  GNSN_TableSupport GetSSRWeaponSupport(int refLevel);
+  GNSN_TableSupport GetSSRPairSupport(int conLevel, int refLevel);
+
+  // ---- #
+  // Queries starting from a banner state other than zero pity.
+  // These reuse the tables for a fresh start (calculating them first if needed),
+  // --- so each query costs one short head for the state plus one convolution with a table.
+  // The results have as many pull counts as the matching table. Returns false for a state or level out of range,
+  // --- and for a pity no one can reach without a five-star, past the pull the rules' rate reaches 100% on
+  // --- ("GetCertainPull()" of the pity rules, 76 on the stock weapon banner, so pity 77 to 79 is rejected), whatever the scalar policy.
+  // ---- #
+
+  bool CalcSSRCharacterFromState(const GNSN_PullState& state, int conLevel, GNSN_ProbArrayT<TScalar>& result);
+  bool CalcSSRWeaponFromState(const GNSN_PullState& state, int refLevel, GNSN_ProbArrayT<TScalar>& result);
+  bool CalcSSRPairFromState(const GNSN_PullState& charState, const GNSN_PullState& weapState, int conLevel, int refLevel, GNSN_ProbArrayT<TScalar>& result);
+
+  // ---- #
+  // Any number of copies, past the levels the tables have, for example 14 for two characters to C6 one after the other.
+  // The first copy convolved with itself by repeated squaring ("GNSN_Convolution::Power()"),
+  // --- so it takes about 2 * log2(copies) convolutions and none of the levels in between.
+  // The result has "copies" strides of pull counts (180 or 240 each). Returns false for fewer than one copy.
+  // ---- #
+
+  bool CalcSSRCharacterCopies(int copies, GNSN_ProbArrayT<TScalar>& result);
+  bool CalcSSRWeaponCopies(int copies, GNSN_ProbArrayT<TScalar>& result);
+
+  // ---- #
+  // Pair tables streamed in blocks of rows, for when keeping all 35 of them (up to 2460 values each) takes too much memory.
+  // Each block of "blockRows" pull counts is worked out for every cell from the character and weapon tables
+  // --- (calculating those first if needed), handed to "sink", and then overwritten by the next block,
+  // --- so the memory it takes grows with the block, not with the tables. No pair table is kept or needed.
+  // "probabilities" and "cumulative" hold "rowCount" rows from pull count "firstPull + 1", each row the 35 cells
+  // --- by constellation then refinement ("row * 35 + conLevel * 5 + refLevel"). A cell has the pull counts of its characters
+  // --- and weapons ("(conLevel + 1) * 180 + (refLevel + 1) * 240" with the stock rules), and rows past those are 0 for it.
+  // The values are the same as the pair tables', up to the last bits of the working precision. The convolutions are of chunks
+  // --- the length of a block, so small blocks take longer: 1024 rows take about twice the time of "CalcSSRPair()", 256 rows about four times.
+  // "OutputSSRPairStream()" writes the same file as "OutputResults()" does for the pair tables, through such a sink.
+  // Both return false for fewer than 1 row per block.
+  // ---- #
+
+  typedef std::function<void(int firstPull, int rowCount, const Value* probabilities, const Value* cumulative)> PairRowSink;
+  bool StreamSSRPair(int blockRows, const PairRowSink& sink);
+  bool OutputSSRPairStream(int blockRows = 256);
+
+  // ---- #
+  // Cumulative queries on the tables, calculating the tables first if needed.
+  // Like the tables above, only the levels a query needs are calculated.
+  // "...CDF()" is the probability to have the level within "pulls" pulls, looked up directly.
+  // "...Quantile()" is the fewest pulls to have the level with at least "probability", found by binary search.
+  // --- Returns -1 when even the most pulls the table has don't get there.
+  // A table with nothing trimmed by the error budget ends at exactly 1, so a probability of 1 gets the pulls that make the level certain,
+  // --- while a trimmed table ends short of 1 by what was trimmed.
+  // "...CDFTable()" gives the full table (indexed by pull count - 1), or null for a level out of range.
+  // ---- #
+
+  double GetSSRCharacterCDF(int conLevel, int pulls);
+  double GetSSRWeaponCDF(int refLevel, int pulls);
+  double GetSSRPairCDF(int conLevel, int refLevel, int pulls);
+  int GetSSRCharacterQuantile(int conLevel, double probability);
+  int GetSSRWeaponQuantile(int refLevel, double probability);
+  int GetSSRPairQuantile(int conLevel, int refLevel, double probability);
+  const Value* GetSSRCharacterCDFTable(int conLevel);
+  const Value* GetSSRWeaponCDFTable(int refLevel);
+  const Value* GetSSRPairCDFTable(int conLevel, int refLevel);
+
+  // ---- #
+  // Binary table files.
+  // "SaveTables()" writes every calculated table to a file (see "calcpulls_binary.h"),
+  // --- and "LoadTables()" maps such a file into memory and uses the tables in it as they are, without calculating anything.
+  // A file from another scalar policy, precision or set of banner rules is rejected, leaving the calculator as it was.
+  // Saving writes a new file and puts it in place of the old one. On POSIX systems that's safe over a file this or any calculator has loaded,
+  // --- which keeps the old one. Windows can't replace a file that is mapped, so there saving over a loaded file returns false
+  // --- and leaves the file as it was; save to another path, or save before loading.
+  // ---- #
+
+  bool SaveTables(const char* path);
+  bool LoadTables(const char* path);
+
+  // The banner rules the tables are calculated with, as text.
+  std::string GetRulesText() const;
+
+  // ---- #
+  // Banner rules, see "calcpulls_rules.h".
+  // Every probability and table size comes from these, and they start as "GNSN_GenshinRules".
+  // The tables of a banner only depend on that banner's rules, and the pair tables on both,
+  // --- so changing the rules cleans the tables of the banners that changed and the pair tables, and keeps the rest.
+  // The source tables of a banner only depend on its pity rules, so they stay too while those are the same.
+  // Sweeping "weapon.specificRate", for example, calculates the weapon and pair tables again from the weapon source tables,
+  // --- but not the character tables.
+  // Returns false, leaving the rules as they were, for rules that don't pass "GNSN_BannerRules::Validate()".
+  // ---- #
+
+  bool SetBannerRules(const GNSN_BannerRules& rules);
+  const GNSN_BannerRules& GetBannerRules() const { return rules; }
+
+  // ---- #
+  // Working precision and output digits.
+  // The MPF tables are calculated with "GetPrecision()" bits (256 by default), and the outputs print "GetOutputDigits()" decimals (24 by default).
+  // "SetAdaptivePrecision()" sets the output digits, and the precision to the fewest bits ("GetRequiredPrecision()")
+  // --- that keep the worst-case error of every table value, after all the convolutions it took, well below the last digit.
+  // "GetErrorBound()" is that worst case at the current precision, as an absolute error of any value in the tables.
+  // Changing the precision cleans the calculator. The native policies have the precision of their type, whatever is set.
+  // The precision belongs to the calculator: every value and temporary it makes gets it when initialized ("mpf_init2()"),
+  // --- and MPIR's global default precision is never read or changed. Calculators share nothing else either,
+  // --- so any number of them, with any precisions, may calculate on different threads at once.
+  // A single calculator is for one thread at a time (besides the threads of its own pool, see "SetThreadCount()").
+  // ---- #
+
+  void SetPrecision(unsigned long bits);
+  unsigned long GetPrecision() const { return precision; }
+  void SetOutputDigits(int digits);
+  int GetOutputDigits() const { return outputDigits; }
+  void SetAdaptivePrecision(int digits);
+  unsigned long GetRequiredPrecision(int digits) const;
+  double GetErrorBound() const;
+
+  // ---- #
+  // Spot checks against exact rationals.
+  // The probability at pull count "pulls" is worked out again from the banner rules with integers only (MPZ and MPQ),
+  // --- and the difference to the table is returned, or -1 for a level or pull count out of range.
+  // The cost grows with the level times the square of "pulls", so these are for checking a few values, not whole tables.
+  // Trimmed tables (see "SetErrorBudget()") are off by up to what they dropped.
+  // ---- #
+
+  double CheckSSRCharacterExact(int conLevel, int pulls);
+  double CheckSSRWeaponExact(int refLevel, int pulls);
+  double CheckSSRPairExact(int conLevel, int refLevel, int pulls);
+
+  // Set how many threads to calculate with (counting the calling thread), where 0 means one per hardware thread.
+  // The results are the same for any count.
+  void SetThreadCount(int threadCount);
+  int GetThreadCount() const { return threadCount; }
+
+  // See "GNSN_PhaseObserver". An empty observer turns it off again.
+  void SetPhaseObserver(const GNSN_PhaseObserver& observer) { phaseObserver = observer; }
+
+#ifdef GNSN_WPROBCALC_STATS
+  // Statistics since the calculator was made or since "ResetStats()", see "calcpulls_stats.h".
+  // "GNSN_CalcStats::ToJSON()" gives them as JSON.
+  const GNSN_CalcStats& GetStats();
+  void ResetStats();
+#endif
+
+private:
+  // A table, for going through all of them in one loop.
+  struct TableRef
+  {
+    Value** table;
+    int count;
+    int stage;
+    GNSN_Arena* arena; // Where it lives, and where a loaded one gets mapped.
+  };
+
+  // Pull counts of the tables per level, from the strides of the banner rules.
+  int CharacterPulls(int conLevel) const { return (conLevel + 1) * rules.character.GetStride(); }
+  int WeaponPulls(int refLevel) const { return (refLevel + 1) * rules.weapon.GetStride(); }
+  int PairPulls(int conLevel, int refLevel) const { return CharacterPulls(conLevel) + WeaponPulls(refLevel); }
+
+  // Set "target" to "rate", as one division like the rest of the calculations.
+  void SetRate(Value& target, const GNSN_Rate& rate) const;
+
+  // Worst-case error of any table value, in roundings of one operation, see "GetErrorBound()".
+  double ErrorGrowth() const;
+  static double CompareExact(const Value& value, mpq_t exact);
+
+  void MarkPhase(const char* phase, bool starting)
+  {
+#ifdef GNSN_WPROBCALC_STATS
+    this->RecordPhase(phase, starting);
+#endif
+    if(phaseObserver)
+      phaseObserver(phase, starting);
+  }
+
+#ifdef GNSN_WPROBCALC_STATS
+  void RecordPhase(const char* phase, bool starting);
+#endif
+
+  void ListTables(std::vector<TableRef>& tables);
+  void CleanSSRCharacter(bool keepSource = false);
+  void CleanSSRWeapon(bool keepSource = false);
+  void CleanSSRPair();
+
+  // Write "rowCount" rows of text to the file at "path", each made by "formatRow(formatter, row)".
+  // With more than one thread, chunks of rows are formatted on the thread pool and written in order.
+  template<class TFormatRow>
+  void WriteRows(const char* path, int rowCount, const TFormatRow& formatRow);
+
+  static GNSN_TableSupport FindSupport(const Value* table, int count);
+  GNSN_TableSupport TrimTable(Value* table, int count, double inherited) const;
+  void ConvolveSupported(Value* target, const Value* a, const GNSN_TableSupport& supportA, const Value* b, const GNSN_TableSupport& supportB,
+    GNSN_SpectrumCache<TScalar>* cacheA = nullptr, GNSN_SpectrumCache<TScalar>* cacheB = nullptr) const;
+  void FindLoadedSupports();
+
+  void CalcSSRCharacterLevel(int conLevel);
+  void CalcSSRCharacterSource();
+  void CalcSSRCharacterFirstCopy();
+  void CalcSSRWeaponLevel(int refLevel);
+  void CalcSSRWeaponSource();
+  void CalcSSRWeaponFirstCopy();
+  void CalcSSRWeaponStates(const Value* nextDist, int nextCount, int fatePoints, bool guaranteed, Value* first);
+  void CalcSSRPairLevel(int conLevel, int refLevel);
+  void AllocSSRPairCell(int conLevel, int refLevel);
+  void CalcSSRPairCell(int conLevel, int refLevel);
+  void StreamSSRPairCell(int conLevel, int refLevel, int firstPull, int rowCount, int blockRows, Value* column, Value* chunk);
+  bool CalcSourceDistFromPity(const Value* srcDist, int hardPity, int pity, Value* result);
+  static void CalcCumulative(const Value* table, int count, bool complete, Value* cdf);
+  static double LookupCDF(const Value* cdf, int count, int pulls);
+  static int SearchQuantile(const Value* cdf, int count, double probability);
+
 
 
 public:
-  ~GNSN_WProbCalc()
+  ~GNSN_WProbCalcT()
   {
     Clean();
   }
-};
\ No newline at end of file
+};
+
+// The scalar policy for "GNSN_WProbCalc" is picked at compile time.
+// Define "GNSN_WPROBCALC_SCALAR" as, for example, "GNSN_ScalarDouble" to get the native float engine.
+#ifndef GNSN_WPROBCALC_SCALAR
+#define GNSN_WPROBCALC_SCALAR GNSN_ScalarMPF
+#endif
+
+typedef GNSN_WProbCalcT<GNSN_WPROBCALC_SCALAR> GNSN_WProbCalc;
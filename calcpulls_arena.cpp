@@ -0,0 +1,48 @@
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "calcpulls_arena.h"
+
+void* GNSN_Arena::Allocate(size_t bytes, size_t alignment)
+{
+  if(bytes == 0)
+    bytes = 1;
+
+  // Find room in the last block, after aligning.
+  if(!this->blocks.empty())
+  {
+    Block& block = this->blocks.back();
+    const uintptr_t start = (uintptr_t)block.memory + this->used;
+    const size_t padding = (size_t)((alignment - start % alignment) % alignment);
+    if(this->used + padding + bytes <= block.size)
+    {
+      this->used += padding + bytes;
+      this->allocated += bytes;
+      return (void*)(start + padding);
+    }
+  }
+
+  // Start a new block, large enough for requests bigger than the usual block size.
+  Block block;
+  block.size = (bytes + alignment > this->blockSize) ? bytes + alignment : this->blockSize;
+  block.memory = static_cast<char*>(std::malloc(block.size));
+  if(block.memory == nullptr)
+    throw std::bad_alloc();
+  this->blocks.push_back(block);
+
+  const uintptr_t start = (uintptr_t)block.memory;
+  const size_t padding = (size_t)((alignment - start % alignment) % alignment);
+  this->used = padding + bytes;
+  this->allocated += bytes;
+  return (void*)(start + padding);
+}
+
+void GNSN_Arena::Release()
+{
+  for(Block& block : this->blocks)
+    std::free(block.memory);
+  this->blocks.clear();
+  this->used = 0;
+  this->allocated = 0;
+}
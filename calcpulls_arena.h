@@ -0,0 +1,46 @@
+#pragma once
+#include <cstddef>
+#include <vector>
+
+// ---- #
+// Arena for the memory of the probability tables.
+// Memory is handed out from large blocks one after another, so a table's values (and for MPF, their limbs) sit together,
+// --- and all of it is freed at once by "Release()" instead of value by value.
+// ---- #
+
+class GNSN_Arena
+{
+private:
+  struct Block
+  {
+    char* memory;
+    size_t size;
+  };
+
+private:
+  std::vector<Block> blocks;
+  size_t blockSize;
+  size_t used = 0;      // Bytes used in the last block.
+  size_t allocated = 0; // Bytes handed out, over all blocks.
+
+public:
+  explicit GNSN_Arena(size_t blockSize = 1 << 20) : blockSize(blockSize) {}
+  ~GNSN_Arena() { Release(); }
+
+  GNSN_Arena(const GNSN_Arena&) = delete;
+  GNSN_Arena& operator=(const GNSN_Arena&) = delete;
+
+  void* Allocate(size_t bytes, size_t alignment = alignof(std::max_align_t));
+
+  template<class T>
+  T* AllocateArray(size_t count)
+  {
+    return static_cast<T*>(Allocate(sizeof(T) * count, alignof(T) > alignof(std::max_align_t) ? alignof(T) : alignof(std::max_align_t)));
+  }
+
+  // Free every block. Anything allocated from the arena is invalid afterwards.
+  void Release();
+
+  size_t GetBytesAllocated() const { return allocated; }
+  size_t GetBlockCount() const { return blocks.size(); }
+};
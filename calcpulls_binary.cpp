@@ -0,0 +1,254 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <mpir.h>
+
+#include "calcpulls.h"
+
+// Binary table files, see "calcpulls_binary.h" for the layout.
+
+template<class TScalar>
+std::string GNSN_WProbCalcT<TScalar>::GetRulesText() const
+{
+  std::string rules = this->rules.Describe();
+
+  // Trimmed tables are only the same with the same budget.
+  if(this->errorBudget > 0.0)
+  {
+    std::ostringstream budget;
+    budget << std::setprecision(17) << "; error budget " << this->errorBudget;
+    rules += budget.str();
+  }
+  return rules;
+}
+
+// Banner rules, see "calcpulls_rules.h".
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::SetBannerRules(const GNSN_BannerRules& rules)
+{
+  if(!rules.Validate())
+    return false;
+  if(rules == this->rules)
+    return true;
+
+  // Tables loaded from a file and kept here still point into it, so the file stays mapped until "Clean()".
+  // The source tables only take the pity rules, so a change to the others keeps them.
+  this->MarkPhase("clean", true);
+  if(rules.character != this->rules.character)
+    this->CleanSSRCharacter(rules.character.pity == this->rules.character.pity);
+  if(rules.weapon != this->rules.weapon)
+    this->CleanSSRWeapon(rules.weapon.pity == this->rules.weapon.pity);
+  this->CleanSSRPair();
+  this->MarkPhase("clean", false);
+  this->rules = rules;
+  return true;
+}
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::SetRate(Value& target, const GNSN_Rate& rate) const
+{
+  Value denominator;
+  TScalar::Init(denominator, this->precision);
+  TScalar::SetD(target, (double)rate.numerator);
+  TScalar::SetD(denominator, (double)rate.denominator);
+  TScalar::Div(target, target, denominator);
+  TScalar::Clear(denominator);
+}
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::ListTables(std::vector<TableRef>& tables)
+{
+  tables.clear();
+
+  // Character tables.
+  tables.push_back(TableRef{ &this->ProbSrc_SSRChar, this->rules.character.pity.hardPity, 1, &this->arenaSrcSSRChar });
+  tables.push_back(TableRef{ &this->ProbSrcDist_SSRChar, this->rules.character.pity.hardPity, 1, &this->arenaSrcSSRChar });
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    tables.push_back(TableRef{ &this->ProbPL_SSRChar[conLevel], this->CharacterPulls(conLevel), 1, &this->arenaSSRChar });
+    tables.push_back(TableRef{ &this->ProbCDF_SSRChar[conLevel], this->CharacterPulls(conLevel), 1, &this->arenaSSRChar });
+  }
+
+  // Weapon tables.
+  tables.push_back(TableRef{ &this->ProbSrc_SSRWeap, this->rules.weapon.pity.hardPity, 2, &this->arenaSrcSSRWeap });
+  tables.push_back(TableRef{ &this->ProbSrcDist_SSRWeap, this->rules.weapon.pity.hardPity, 2, &this->arenaSrcSSRWeap });
+  for(int refLevel = 0; refLevel < 5; refLevel++)
+  {
+    tables.push_back(TableRef{ &this->ProbPL_SSRWeap[refLevel], this->WeaponPulls(refLevel), 2, &this->arenaSSRWeap });
+    tables.push_back(TableRef{ &this->ProbCDF_SSRWeap[refLevel], this->WeaponPulls(refLevel), 2, &this->arenaSSRWeap });
+  }
+
+  // Pair tables.
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    for(int refLevel = 0; refLevel < 5; refLevel++)
+    {
+      int maxPulls = this->PairPulls(conLevel, refLevel);
+      tables.push_back(TableRef{ &this->ProbPL_SSRPair[conLevel][refLevel], maxPulls, 4, &this->arenaSSRPair });
+      tables.push_back(TableRef{ &this->ProbCDF_SSRPair[conLevel][refLevel], maxPulls, 4, &this->arenaSSRPair });
+    }
+  }
+}
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::SaveTables(const char* path)
+{
+  // Setup the header.
+  GNSN_TableFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, "GNSNWPC", 8);
+  header.version = GNSN_TableFileHeader::kVersion;
+  header.byteOrder = GNSN_TableFileHeader::kByteOrder;
+  std::strncpy(header.scalar, TScalar::Name(), sizeof(header.scalar) - 1);
+  header.limbBytes = sizeof(mp_limb_t);
+  header.precision = (uint32_t)TScalar::StoredPrecision(this->precision);
+  header.initialized = (uint32_t)this->initialized;
+  std::string rules = this->GetRulesText();
+  header.rulesBytes = (uint32_t)rules.size();
+  header.rulesHash = GNSN_HashText(rules.c_str());
+  const size_t entriesOffset = GNSN_TableFileHeader::EntriesOffset(header.rulesBytes);
+
+  // Place the tables that are calculated.
+  std::vector<TableRef> tables;
+  this->ListTables(tables);
+  std::vector<TableRef> stored;
+  std::vector<GNSN_TableFileEntry> entries;
+  for(const TableRef& table : tables)
+  {
+    if((this->initialized & table.stage) == table.stage)
+      stored.push_back(table);
+  }
+  header.tableCount = (uint32_t)stored.size();
+
+  const size_t alignment = GNSN_TableFileHeader::kTableAlignment;
+  uint64_t offset = entriesOffset + stored.size() * sizeof(GNSN_TableFileEntry);
+  for(const TableRef& table : stored)
+  {
+    GNSN_TableFileEntry entry;
+    offset = (offset + alignment - 1) / alignment * alignment;
+    entry.stage = (uint32_t)table.stage;
+    entry.count = (uint32_t)table.count;
+    entry.offset = offset;
+    entry.bytes = TScalar::StoredBytes(table.count, header.precision);
+    entries.push_back(entry);
+    offset += entry.bytes;
+  }
+
+  // Write everything, to a file of its own first.
+  // The file at "path" may be mapped, by "LoadTables()" of this or another calculator, and truncating it would pull it from under them.
+  const std::string temporary = GNSN_TemporaryPath(path);
+  std::ofstream ofs(temporary, std::ofstream::out | std::ofstream::trunc | std::ofstream::binary);
+  if(!ofs)
+    return false;
+  ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  std::vector<char> rulesText(entriesOffset - sizeof(header), 0);
+  std::memcpy(rulesText.data(), rules.data(), rules.size());
+  ofs.write(rulesText.data(), (std::streamsize)rulesText.size());
+  if(!entries.empty())
+    ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(GNSN_TableFileEntry));
+
+  std::vector<char> buffer;
+  uint64_t written = entriesOffset + entries.size() * sizeof(GNSN_TableFileEntry);
+  for(size_t i = 0; i < stored.size(); i++)
+  {
+    const GNSN_TableFileEntry& entry = entries[i];
+    const Value* values = *stored[i].table;
+    buffer.assign((size_t)(entry.offset - written + entry.bytes), 0);
+    TScalar::Store(values, (int)entry.count, header.precision, buffer.data() + (entry.offset - written));
+    ofs.write(buffer.data(), (std::streamsize)buffer.size());
+    written = entry.offset + entry.bytes;
+  }
+  ofs.close();
+  if(ofs.fail())
+  {
+    std::remove(temporary.c_str());
+    return false;
+  }
+  return GNSN_ReplaceFile(temporary.c_str(), path);
+}
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::LoadTables(const char* path)
+{
+  std::unique_ptr<GNSN_MappedFile> file(new GNSN_MappedFile());
+  if(!file->Open(path) || file->GetSize() < sizeof(GNSN_TableFileHeader))
+    return false;
+
+  // Check that the file is one this calculator would have written.
+  GNSN_TableFileHeader header;
+  std::memcpy(&header, file->GetData(), sizeof(header));
+  header.scalar[sizeof(header.scalar) - 1] = '\0';
+  std::string rules = this->GetRulesText();
+  if(std::memcmp(header.magic, "GNSNWPC", 8) != 0
+    || header.version != GNSN_TableFileHeader::kVersion
+    || header.byteOrder != GNSN_TableFileHeader::kByteOrder
+    || std::strcmp(header.scalar, TScalar::Name()) != 0
+    || header.limbBytes != sizeof(mp_limb_t)
+    || header.precision != (uint32_t)TScalar::StoredPrecision(this->precision)
+    || (header.initialized & ~7u) != 0
+    || header.rulesBytes != rules.size()
+    || header.rulesHash != GNSN_HashText(rules.c_str())
+    || file->GetSize() < GNSN_TableFileHeader::EntriesOffset(header.rulesBytes)
+    || std::memcmp(file->GetData() + sizeof(header), rules.data(), rules.size()) != 0)
+    return false;
+
+  // Check the entries against the tables they should be.
+  std::vector<TableRef> tables;
+  this->ListTables(tables);
+  std::vector<TableRef> stored;
+  for(const TableRef& table : tables)
+  {
+    if((header.initialized & table.stage) == (uint32_t)table.stage)
+      stored.push_back(table);
+  }
+  const size_t entriesOffset = GNSN_TableFileHeader::EntriesOffset(header.rulesBytes);
+  const size_t entriesEnd = entriesOffset + stored.size() * sizeof(GNSN_TableFileEntry);
+  if(header.tableCount != stored.size() || file->GetSize() < entriesEnd)
+    return false;
+
+  std::vector<GNSN_TableFileEntry> entries(stored.size());
+  if(!entries.empty())
+    std::memcpy(entries.data(), file->GetData() + entriesOffset, entries.size() * sizeof(GNSN_TableFileEntry));
+  for(size_t i = 0; i < stored.size(); i++)
+  {
+    const GNSN_TableFileEntry& entry = entries[i];
+    if(entry.stage != (uint32_t)stored[i].stage
+      || entry.count != (uint32_t)stored[i].count
+      || entry.offset % GNSN_TableFileHeader::kTableAlignment != 0
+      || entry.offset < entriesEnd
+      || entry.bytes != TScalar::StoredBytes(stored[i].count, header.precision)
+      || entry.offset + entry.bytes > file->GetSize())
+      return false;
+  }
+
+  // Swap the tables over to the file.
+  this->Clean();
+  for(size_t i = 0; i < stored.size(); i++)
+  {
+    const GNSN_TableFileEntry& entry = entries[i];
+    *stored[i].table = TScalar::MapStored(file->GetData() + entry.offset, (int)entry.count, header.precision, *stored[i].arena);
+  }
+  this->initialized = (int)header.initialized;
+  this->sourcesSSR = this->initialized & 3;
+  this->levelsSSRChar = (this->initialized & 1) ? (1 << 7) - 1 : 0;
+  this->levelsSSRWeap = (this->initialized & 2) ? (1 << 5) - 1 : 0;
+  this->cellsSSRPair = (this->initialized & 4) ? ((uint64_t)1 << 35) - 1 : 0;
+  this->FindLoadedSupports();
+  this->mappedTables = std::move(file);
+  return true;
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template std::string GNSN_WProbCalcT<TScalar>::GetRulesText() const; \
+  template bool GNSN_WProbCalcT<TScalar>::SetBannerRules(const GNSN_BannerRules&); \
+  template void GNSN_WProbCalcT<TScalar>::SetRate(TScalar::Value&, const GNSN_Rate&) const; \
+  template void GNSN_WProbCalcT<TScalar>::ListTables(std::vector<TableRef>&); \
+  template bool GNSN_WProbCalcT<TScalar>::SaveTables(const char*); \
+  template bool GNSN_WProbCalcT<TScalar>::LoadTables(const char*);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
@@ -0,0 +1,80 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// ---- #
+// Binary table files.
+//
+// Layout, in the byte order of the machine that wrote it:
+// --- (1) "GNSN_TableFileHeader",
+// --- (2) the banner rules the tables were calculated with, as "rulesBytes" characters of text, padded with zeros to a multiple of 8 bytes,
+// --- (3) "tableCount" "GNSN_TableFileEntry"s, in the order the calculator lists its tables,
+// --- (4) the stored tables, each starting at a multiple of "kTableAlignment" bytes.
+// How a table's values are stored is up to the scalar policy (see "Store()" in "calcpulls_scalar.h").
+// ---- #
+
+struct GNSN_TableFileHeader
+{
+  static const uint32_t kVersion = 2;
+  static const uint32_t kByteOrder = 0x01020304;
+  static const size_t kTableAlignment = 64;
+
+  char magic[8];          // "GNSNWPC" and a zero.
+  uint32_t version;       // "kVersion".
+  uint32_t byteOrder;     // "kByteOrder", as written by the machine that wrote the file.
+  char scalar[16];        // "TScalar::Name()".
+  uint32_t limbBytes;     // "sizeof(mp_limb_t)".
+  uint32_t precision;     // "TScalar::StoredPrecision()".
+  uint32_t initialized;   // Which of the character, weapon and pair tables the file has (the calculator's "initialized").
+  uint32_t tableCount;    // Entries following the header.
+  uint64_t rulesHash;     // Hash of the rules text, to check before comparing it.
+  uint32_t rulesBytes;    // Length of the rules text following the header.
+  uint32_t reserved;      // Zero.
+
+  // Where the entries start, after the rules text.
+  static size_t EntriesOffset(uint32_t rulesBytes) { return sizeof(GNSN_TableFileHeader) + ((size_t)rulesBytes + 7) / 8 * 8; }
+};
+
+struct GNSN_TableFileEntry
+{
+  uint32_t stage;   // 1 for character tables, 2 for weapon tables, 4 for pair tables.
+  uint32_t count;   // Values in the table.
+  uint64_t offset;  // From the start of the file.
+  uint64_t bytes;   // Stored size.
+};
+
+// 64-bit FNV-1a.
+uint64_t GNSN_HashText(const char* text);
+
+// A path next to "path", unique to this process and call, to write a file at before it replaces "path".
+std::string GNSN_TemporaryPath(const char* path);
+
+// Put the file at "from" in the place of "to" in one step, so anything mapping the file at "to" keeps the one it had (POSIX).
+// On Windows, this fails while "to" is mapped anywhere. Removes "from" if it can't.
+bool GNSN_ReplaceFile(const char* from, const char* to);
+
+// A whole file mapped into memory, as a private copy on write mapping.
+class GNSN_MappedFile
+{
+private:
+  char* data = nullptr;
+  size_t size = 0;
+#ifdef _WIN32
+  void* fileHandle = nullptr;
+  void* mappingHandle = nullptr;
+#endif
+
+public:
+  GNSN_MappedFile() {}
+  ~GNSN_MappedFile() { Close(); }
+
+  GNSN_MappedFile(const GNSN_MappedFile&) = delete;
+  GNSN_MappedFile& operator=(const GNSN_MappedFile&) = delete;
+
+  bool Open(const char* path);
+  void Close();
+
+  char* GetData() const { return data; }
+  size_t GetSize() const { return size; }
+};
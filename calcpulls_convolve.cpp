@@ -0,0 +1,82 @@
+#include <cmath>
+#include <complex>
+#include <utility>
+#include <vector>
+
+#include "calcpulls_convolve.h"
+
+GNSN_FFT::GNSN_FFT(int size)
+{
+  this->size = size;
+
+  // Compute the roots in long double, so they don't add to the error of the transform more than they have to.
+  const long double pi = 3.141592653589793238462643383279502884L;
+  this->roots.resize(size / 2);
+  for(int k = 0; k < size / 2; k++)
+  {
+    const long double angle = -2.0L * pi * k / size;
+    this->roots[k] = std::complex<double>((double)std::cos(angle), (double)std::sin(angle));
+  }
+
+  int bits = 0;
+  while((1 << bits) < size)
+    bits++;
+  this->reversed.resize(size);
+  for(int index = 0; index < size; index++)
+  {
+    int result = 0;
+    for(int bit = 0; bit < bits; bit++)
+    {
+      if(index & (1 << bit))
+        result |= 1 << (bits - 1 - bit);
+    }
+    this->reversed[index] = result;
+  }
+}
+
+int GNSN_FFT::SizeFor(int count)
+{
+  int result = 1;
+  while(result < count)
+    result <<= 1;
+  return result;
+}
+
+void GNSN_FFT::Forward(std::complex<double>* values) const
+{
+  Transform(values, false);
+}
+
+void GNSN_FFT::Inverse(std::complex<double>* values) const
+{
+  Transform(values, true);
+}
+
+// Iterative radix-2 transform.
+void GNSN_FFT::Transform(std::complex<double>* values, bool inverse) const
+{
+  for(int index = 0; index < size; index++)
+  {
+    if(index < reversed[index])
+      std::swap(values[index], values[reversed[index]]);
+  }
+
+  for(int length = 2; length <= size; length <<= 1)
+  {
+    const int half = length / 2;
+    const int step = size / length;
+    for(int start = 0; start < size; start += length)
+    {
+      for(int k = 0; k < half; k++)
+      {
+        std::complex<double> root = roots[k * step];
+        if(inverse)
+          root = std::conj(root);
+        const std::complex<double> u = values[start + k];
+        const std::complex<double> v = values[start + k + half] * root;
+        values[start + k] = u + v;
+        values[start + k + half] = u - v;
+      }
+    }
+  }
+}
@@ -0,0 +1,482 @@
+#pragma once
+#include <cmath>
+#include <complex>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "calcpulls_arena.h"
+#include "calcpulls_scalar.h"
+
+// ---- #
+// Fast Fourier transform on doubles, for power of two sizes.
+// ---- #
+
+class GNSN_FFT
+{
+private:
+  int size = 0;
+  std::vector<std::complex<double>> roots; // "size / 2" roots of unity.
+  std::vector<int> reversed;              // Bit reversed index for each index.
+
+public:
+  explicit GNSN_FFT(int size);
+
+  int GetSize() const { return size; }
+
+  // In place transform of "size" values.
+  // The inverse transform doesn't divide by "size".
+  void Forward(std::complex<double>* values) const;
+  void Inverse(std::complex<double>* values) const;
+
+  // The smallest power of two at least as large as "count".
+  static int SizeFor(int count);
+
+private:
+  void Transform(std::complex<double>* values, bool inverse) const;
+};
+
+
+
+// ---- #
+// Convolution of probability tables.
+// "target[i + j + offset] += a[i] * b[j]" for every "i" and "j".
+//
+// A scalar policy with a kernel of its own ("TScalar::AccumulateKernel()") convolves with that.
+// Otherwise, short tables are convolved directly.
+// Long tables go through a "split" FFT that is exact for integers:
+// --- (1) each value is rounded down to a fixed point number with "TScalar::ConvolutionBits()" bits below the binary point (for MPF, 32 more than the values have),
+// --- (2) the fixed point numbers are cut into pieces of "bitsPerPiece" bits, small enough for the FFT of the pieces to round back to exact integers,
+// --- (3) the pieces are convolved with each other through FFTs, giving one "digit" per sum of piece positions,
+// --- (4) the digits are put back together into a fixed point number and added to "target" through "TScalar::AddFixed()".
+// So the only error is the rounding down in (1), no matter how many digits the values have.
+// If the FFT ever fails to land close to exact integers, the tables are convolved directly instead.
+// Values have to be in [0, 1].
+// A table convolved with several others can keep the transforms of its pieces in a "GNSN_SpectrumCache", so they are made once.
+// ---- #
+
+template<class TScalar>
+class GNSN_SpectrumCache;
+
+template<class TScalar>
+class GNSN_Convolution
+{
+public:
+  typedef typename TScalar::Value Value;
+
+  // How two tables go through the FFT: its size, and the pieces each value is cut into.
+  struct Layout
+  {
+    int size;
+    int bitsPerPiece;
+    int pieceCount;
+    unsigned long fracBits; // Bits below the binary point of the fixed point numbers, see "TScalar::ConvolutionBits()".
+  };
+
+  // The FFT of each piece of a table, for one layout.
+  struct Spectrum
+  {
+    Layout layout;
+    std::vector<std::complex<double>> pieces; // "pieceCount" transforms of "size" values, one after the other.
+  };
+
+  // Below this length (of the shorter table), direct convolution is about as fast.
+  static const int kDirectLength = 64;
+
+  // Bits an FFT output can use while still rounding to the exact integer, with room to spare.
+  static const int kExactBits = 48;
+
+  // Furthest an FFT output may be from an integer, before the result isn't trusted.
+  static constexpr double kMaxRoundingError = 0.125;
+
+public:
+  // "precision" is the precision of the values (see "TScalar::Init()"), for the temporaries.
+  // "cacheA" and "cacheB", if given, keep the transforms of "a" and "b" for the next convolutions with them.
+  static void Accumulate(Value* target, const Value* a, int countA, const Value* b, int countB, int offset, unsigned long precision,
+    GNSN_SpectrumCache<TScalar>* cacheA = nullptr, GNSN_SpectrumCache<TScalar>* cacheB = nullptr)
+  {
+    if(countA <= 0 || countB <= 0)
+      return;
+
+    if(TScalar::AccumulateKernel(target, a, countA, b, countB, offset))
+      return;
+    if(countA < kDirectLength || countB < kDirectLength || !AccumulateFFT(target, a, countA, b, countB, offset, precision, cacheA, cacheB))
+      AccumulateDirect(target, a, countA, b, countB, offset, precision);
+  }
+
+  static void AccumulateDirect(Value* target, const Value* a, int countA, const Value* b, int countB, int offset, unsigned long precision)
+  {
+    Value product;
+    TScalar::Init(product, precision);
+    for(int indexA = 0; indexA < countA; indexA++)
+    {
+      for(int indexB = 0; indexB < countB; indexB++)
+      {
+        TScalar::Mul(product, a[indexA], b[indexB]);
+        Value& tarMemAdd = target[indexA + indexB + offset];
+        TScalar::Add(tarMemAdd, tarMemAdd, product);
+      }
+    }
+    TScalar::Clear(product);
+  }
+
+  // Returns false, without touching "target", if the FFT wasn't accurate enough.
+  static bool AccumulateFFT(Value* target, const Value* a, int countA, const Value* b, int countB, int offset, unsigned long precision,
+    GNSN_SpectrumCache<TScalar>* cacheA = nullptr, GNSN_SpectrumCache<TScalar>* cacheB = nullptr)
+  {
+    const Layout layout = LayoutFor(countA, countB, precision);
+    const GNSN_FFT fft(layout.size);
+
+    // The transforms of a table with a cache come from there, made now if they aren't yet.
+    std::shared_ptr<const Spectrum> spectrumA, spectrumB;
+    if(cacheA != nullptr)
+      spectrumA = cacheA->Get(fft, layout, a, countA);
+    else
+      spectrumA = MakeSpectrum(fft, layout, a, countA);
+    if(cacheB != nullptr)
+      spectrumB = cacheB->Get(fft, layout, b, countB);
+    else
+      spectrumB = MakeSpectrum(fft, layout, b, countB);
+    return AccumulateSpectra(target, countA + countB - 1, offset, fft, *spectrumA, *spectrumB);
+  }
+
+  // The layout for convolving tables of "countA" and "countB" values of "precision" bits.
+  static Layout LayoutFor(int countA, int countB, unsigned long precision)
+  {
+    Layout layout;
+    layout.size = GNSN_FFT::SizeFor(countA + countB - 1);
+    layout.fracBits = TScalar::ConvolutionBits(precision);
+
+    // Each digit sums at most "min(countA, countB) * pieceCount" products of two pieces,
+    // --- and the FFT error grows with the logarithm of its size.
+    const unsigned long fracBits = layout.fracBits;
+    const int headroom = CeilLog2(countA < countB ? countA : countB) + CeilLog2(CeilLog2(layout.size));
+    layout.bitsPerPiece = 16;
+    layout.pieceCount = 0;
+    for(; layout.bitsPerPiece > 1; layout.bitsPerPiece--)
+    {
+      layout.pieceCount = 1 + (int)((fracBits + layout.bitsPerPiece - 1) / layout.bitsPerPiece); // One more piece for the integer part.
+      if(2 * layout.bitsPerPiece + headroom + CeilLog2(layout.pieceCount) <= kExactBits)
+        break;
+    }
+    return layout;
+  }
+
+  static std::shared_ptr<const Spectrum> MakeSpectrum(const GNSN_FFT& fft, const Layout& layout, const Value* values, int count)
+  {
+    std::shared_ptr<Spectrum> spectrum(new Spectrum());
+    spectrum->layout = layout;
+    SplitSpectra(fft, values, count, layout.fracBits, layout.bitsPerPiece, layout.pieceCount, spectrum->pieces);
+    return spectrum;
+  }
+
+  // The convolution of two tables from their transforms, which have to have the same layout, with "countOut" values.
+  static bool AccumulateSpectra(Value* target, int countOut, int offset, const GNSN_FFT& fft, const Spectrum& a, const Spectrum& b)
+  {
+    const int size = fft.GetSize();
+    const int bitsPerPiece = a.layout.bitsPerPiece;
+    const int pieceCount = a.layout.pieceCount;
+    const std::vector<std::complex<double>>& spectrumA = a.pieces;
+    const std::vector<std::complex<double>>& spectrumB = b.pieces;
+
+    // Digits past "pieceCount + 2" would only add to bits well below "fracBits".
+    const int digitCount = (pieceCount + 2 < 2 * pieceCount - 1) ? pieceCount + 2 : 2 * pieceCount - 1;
+
+    // Multiply the spectra for every pair of pieces, two digits per inverse transform.
+    std::vector<double> digits((size_t)digitCount * countOut);
+    std::vector<std::complex<double>> work(size);
+    double worstError = 0.0;
+    for(int digit = 0; digit < digitCount; digit += 2)
+    {
+      for(int k = 0; k < size; k++)
+        work[k] = 0.0;
+      for(int part = 0; part < 2 && digit + part < digitCount; part++)
+      {
+        const std::complex<double> scale = (part == 0) ? std::complex<double>(1.0, 0.0) : std::complex<double>(0.0, 1.0);
+        const int sum = digit + part;
+        for(int pieceA = (sum < pieceCount ? 0 : sum - pieceCount + 1); pieceA < pieceCount && pieceA <= sum; pieceA++)
+        {
+          const std::complex<double>* sA = &spectrumA[(size_t)pieceA * size];
+          const std::complex<double>* sB = &spectrumB[(size_t)(sum - pieceA) * size];
+          for(int k = 0; k < size; k++)
+            work[k] += scale * sA[k] * sB[k];
+        }
+      }
+      fft.Inverse(work.data());
+
+      for(int n = 0; n < countOut; n++)
+      {
+        for(int part = 0; part < 2 && digit + part < digitCount; part++)
+        {
+          const double raw = (part == 0 ? work[n].real() : work[n].imag()) / size;
+          const double rounded = std::floor(raw + 0.5);
+          const double error = std::fabs(raw - rounded);
+          worstError = (error > worstError) ? error : worstError;
+          digits[(size_t)(digit + part) * countOut + n] = (rounded > 0.0) ? rounded : 0.0;
+        }
+      }
+    }
+    if(worstError > kMaxRoundingError)
+      return false;
+
+    // Put the digits back together.
+    // Digit "d" is worth 2^(-bitsPerPiece * d), so with "outBits" bits below the binary point it starts at bit "bitsPerPiece * (digitCount - 1 - d)".
+    const unsigned long outBits = (unsigned long)bitsPerPiece * (digitCount - 1);
+    const int wordCount = (int)((outBits + 64 + 63) / 64) + 1;
+    std::vector<uint64_t> words(wordCount);
+    typename TScalar::FixedScratch scratch((unsigned long)wordCount * 64 + 64);
+    for(int n = 0; n < countOut; n++)
+    {
+      for(int i = 0; i < wordCount; i++)
+        words[i] = 0;
+      bool nonZero = false;
+      for(int digit = 0; digit < digitCount; digit++)
+      {
+        const uint64_t value = (uint64_t)digits[(size_t)digit * countOut + n];
+        if(value == 0)
+          continue;
+        AddShifted(words.data(), wordCount, value, (unsigned long)bitsPerPiece * (digitCount - 1 - digit));
+        nonZero = true;
+      }
+      if(nonZero)
+        TScalar::AddFixed(scratch, target[n + offset], words.data(), wordCount, outBits);
+    }
+    return true;
+  }
+
+  // ---- #
+  // Convolution power: "base" convolved with itself until there are "exponent" copies of it, each convolution with "offset".
+  // By repeated squaring, so it takes at most 2 * log2(exponent) convolutions, and only the squares in between are kept.
+  // "target" gets set (not added to) for the "PowerLength()" values the result has.
+  // ---- #
+
+  static int PowerLength(int count, int exponent, int offset)
+  {
+    return exponent * count + (exponent - 1) * (offset - 1);
+  }
+
+  static void Power(Value* target, const Value* base, int count, int exponent, int offset, unsigned long precision)
+  {
+    if(exponent <= 0 || count <= 0)
+      return;
+
+    GNSN_Arena scratch;
+    const Value* square = base;
+    int squareLength = count;
+    const Value* result = nullptr; // Nothing yet, which is the same as a single 1 with no offset.
+    int resultLength = 0;
+    for(int remaining = exponent; ; )
+    {
+      if((remaining & 1) != 0)
+      {
+        if(result == nullptr)
+        {
+          result = square;
+          resultLength = squareLength;
+        }
+        else
+        {
+          const int length = resultLength + squareLength - 1 + offset;
+          Value* product = scratch.AllocateArray<Value>(length);
+          TScalar::InitArray(product, length, precision, scratch);
+          AccumulateNonZero(product, result, resultLength, square, squareLength, offset, precision);
+          result = product;
+          resultLength = length;
+        }
+      }
+      remaining >>= 1;
+      if(remaining == 0)
+        break;
+
+      const int length = 2 * squareLength - 1 + offset;
+      Value* product = scratch.AllocateArray<Value>(length);
+      TScalar::InitArray(product, length, precision, scratch);
+      AccumulateNonZero(product, square, squareLength, square, squareLength, offset, precision);
+      square = product;
+      squareLength = length;
+    }
+
+    for(int index = 0; index < resultLength; index++)
+      TScalar::Set(target[index], result[index]);
+  }
+
+private:
+  // "Accumulate()" over the part of each table between its first and last value that isn't zero.
+  static void AccumulateNonZero(Value* target, const Value* a, int countA, const Value* b, int countB, int offset, unsigned long precision)
+  {
+    int firstA = 0, firstB = 0;
+    while(firstA < countA && TScalar::CmpD(a[firstA], 0.0) == 0)
+      firstA++;
+    while(countA > firstA && TScalar::CmpD(a[countA - 1], 0.0) == 0)
+      countA--;
+    while(firstB < countB && TScalar::CmpD(b[firstB], 0.0) == 0)
+      firstB++;
+    while(countB > firstB && TScalar::CmpD(b[countB - 1], 0.0) == 0)
+      countB--;
+    Accumulate(target, a + firstA, countA - firstA, b + firstB, countB - firstB, offset + firstA + firstB, precision);
+  }
+
+  static int CeilLog2(int value)
+  {
+    int result = 0;
+    while((1 << result) < value)
+      result++;
+    return result;
+  }
+
+  // Store in "spectra", the FFT of each piece of the fixed point form of "values".
+  // Piece 0 is the integer part, piece "p" holds the bits worth 2^(-bitsPerPiece * p) and below.
+  static void SplitSpectra(const GNSN_FFT& fft, const Value* values, int count, unsigned long fracBits,
+    int bitsPerPiece, int pieceCount, std::vector<std::complex<double>>& spectra)
+  {
+    const int size = fft.GetSize();
+    const int wordCount = (int)((fracBits + 63) / 64) + 1;
+    std::vector<uint64_t> words(wordCount);
+    std::vector<double> pieces((size_t)pieceCount * size, 0.0);
+    typename TScalar::FixedScratch scratch((unsigned long)wordCount * 64 + 64);
+
+    for(int n = 0; n < count; n++)
+    {
+      TScalar::GetFixed(scratch, values[n], fracBits, words.data(), wordCount);
+      for(int piece = 0; piece < pieceCount; piece++)
+      {
+        // The lowest bit of this piece, which runs past the end of the fixed point number for the last piece.
+        const long low = (long)fracBits - (long)bitsPerPiece * piece;
+        pieces[(size_t)piece * size + n] = (double)ExtractBits(words.data(), wordCount, low, piece == 0 ? 64 : bitsPerPiece);
+      }
+    }
+
+    // Two real pieces per complex transform, then separate them through the symmetry of real transforms.
+    spectra.assign((size_t)pieceCount * size, 0.0);
+    std::vector<std::complex<double>> work(size);
+    for(int piece = 0; piece < pieceCount; piece += 2)
+    {
+      const bool paired = piece + 1 < pieceCount;
+      for(int k = 0; k < size; k++)
+        work[k] = std::complex<double>(pieces[(size_t)piece * size + k], paired ? pieces[(size_t)(piece + 1) * size + k] : 0.0);
+      fft.Forward(work.data());
+
+      std::complex<double>* first = &spectra[(size_t)piece * size];
+      for(int k = 0; k < size; k++)
+      {
+        const std::complex<double> z = work[k];
+        const std::complex<double> mirror = std::conj(work[(size - k) & (size - 1)]);
+        first[k] = (z + mirror) * 0.5;
+        if(paired)
+          spectra[(size_t)(piece + 1) * size + k] = (z - mirror) * std::complex<double>(0.0, -0.5);
+      }
+    }
+  }
+
+  // The "bitCount" bits of a fixed point number starting at bit "low" (which may be negative, reading zeroes).
+  static uint64_t ExtractBits(const uint64_t* words, int wordCount, long low, int bitCount)
+  {
+    uint64_t result = 0;
+    for(int bit = 0; bit < bitCount; )
+    {
+      const long position = low + bit;
+      if(position < 0)
+      {
+        bit += (int)((-position < bitCount - bit) ? -position : bitCount - bit);
+        continue;
+      }
+      const long word = position / 64;
+      if(word >= wordCount)
+        break;
+      const int shift = (int)(position % 64);
+      int take = 64 - shift;
+      take = (take < bitCount - bit) ? take : bitCount - bit;
+      const uint64_t mask = (take == 64) ? ~(uint64_t)0 : (((uint64_t)1 << take) - 1);
+      result |= ((words[word] >> shift) & mask) << bit;
+      bit += take;
+    }
+    return result;
+  }
+
+  // Add "value" shifted left by "shift" bits to a fixed point number.
+  static void AddShifted(uint64_t* words, int wordCount, uint64_t value, unsigned long shift)
+  {
+    int word = (int)(shift / 64);
+    const int bit = (int)(shift % 64);
+    uint64_t low = value << bit;
+    uint64_t high = (bit == 0) ? 0 : (value >> (64 - bit));
+    for(; word < wordCount && (low != 0 || high != 0); word++)
+    {
+      const uint64_t before = words[word];
+      words[word] = before + low;
+      const uint64_t carry = (words[word] < before) ? 1 : 0;
+      low = high + carry;
+      high = (low < carry) ? 1 : 0;
+    }
+  }
+};
+
+
+
+// ---- #
+// Transforms of tables kept between convolutions, by table and layout.
+// A table convolved with several others (like a character level with every weapon level) is transformed once per layout,
+// --- and kept until "Clear()", which has to come before any of the tables changes or goes away.
+// Any number of threads may convolve with the same cache at once. A missing transform is made outside the lock,
+// --- so two threads may both make it, and the first one in is kept.
+// ---- #
+
+template<class TScalar>
+class GNSN_SpectrumCache
+{
+public:
+  typedef typename TScalar::Value Value;
+  typedef typename GNSN_Convolution<TScalar>::Layout Layout;
+  typedef typename GNSN_Convolution<TScalar>::Spectrum Spectrum;
+
+private:
+  struct Entry
+  {
+    const Value* values;
+    int count;
+    std::shared_ptr<const Spectrum> spectrum;
+  };
+
+private:
+  std::mutex mutex;
+  std::vector<Entry> entries;
+
+public:
+  std::shared_ptr<const Spectrum> Get(const GNSN_FFT& fft, const Layout& layout, const Value* values, int count)
+  {
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      const Entry* entry = this->Find(layout, values, count);
+      if(entry != nullptr)
+        return entry->spectrum;
+    }
+
+    std::shared_ptr<const Spectrum> spectrum = GNSN_Convolution<TScalar>::MakeSpectrum(fft, layout, values, count);
+    std::lock_guard<std::mutex> lock(this->mutex);
+    const Entry* entry = this->Find(layout, values, count);
+    if(entry != nullptr)
+      return entry->spectrum;
+    this->entries.push_back(Entry{ values, count, spectrum });
+    return spectrum;
+  }
+
+  void Clear()
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->entries.clear();
+  }
+
+private:
+  const Entry* Find(const Layout& layout, const Value* values, int count) const
+  {
+    for(const Entry& entry : this->entries)
+    {
+      const Layout& other = entry.spectrum->layout;
+      if(entry.values == values && entry.count == count
+        && other.size == layout.size && other.bitsPerPiece == layout.bitsPerPiece && other.pieceCount == layout.pieceCount
+        && other.fracBits == layout.fracBits)
+        return &entry;
+    }
+    return nullptr;
+  }
+};
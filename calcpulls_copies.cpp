@@ -0,0 +1,43 @@
+#include <iostream>
+#include <climits>
+#include <mpir.h>
+
+#include "calcpulls.h"
+#include "calcpulls_convolve.h"
+
+// Copies past the levels of the tables.
+// Every copy after the first takes the same pulls as the first copy did, from zero pity without a guarantee,
+// --- so "n" copies is the first copy table convolved with itself "n - 1" times.
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::CalcSSRCharacterCopies(int copies, GNSN_ProbArrayT<TScalar>& result)
+{
+  const int stride = this->rules.character.GetStride();
+  if(copies < 1 || copies > INT_MAX / stride)
+    return false;
+  this->CalcSSRCharacterLevel(0);
+
+  result.Reset(copies * stride, this->precision);
+  GNSN_Convolution<TScalar>::Power(result.GetValues(), this->ProbPL_SSRChar[0], stride, copies, 1, this->precision);
+  return true;
+}
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::CalcSSRWeaponCopies(int copies, GNSN_ProbArrayT<TScalar>& result)
+{
+  const int stride = this->rules.weapon.GetStride();
+  if(copies < 1 || copies > INT_MAX / stride)
+    return false;
+  this->CalcSSRWeaponLevel(0);
+
+  result.Reset(copies * stride, this->precision);
+  GNSN_Convolution<TScalar>::Power(result.GetValues(), this->ProbPL_SSRWeap[0], stride, copies, 1, this->precision);
+  return true;
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template bool GNSN_WProbCalcT<TScalar>::CalcSSRCharacterCopies(int, GNSN_ProbArrayT<TScalar>&); \
+  template bool GNSN_WProbCalcT<TScalar>::CalcSSRWeaponCopies(int, GNSN_ProbArrayT<TScalar>&);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
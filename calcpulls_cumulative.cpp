@@ -0,0 +1,154 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <mpir.h>
+
+#include "calcpulls.h"
+
+// Cumulative probabilities and the queries on them.
+// Each table gets a running sum next to it, so the probability to have a level within some number of pulls is a single lookup,
+// --- and the pulls needed for some probability is a binary search, since the sums never decrease.
+// A table that has all of its distribution (nothing trimmed by the error budget) ends where its level is certain,
+// --- so its sums end at exactly 1 and never pass it, whatever its rounded values add up to.
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcCumulative(const Value* table, int count, bool complete, Value* cdf)
+{
+  if(count <= 0)
+    return;
+
+  TScalar::Set(cdf[0], table[0]);
+  for(int pullCount = 1; pullCount < count; pullCount++)
+  {
+    TScalar::Add(cdf[pullCount], cdf[pullCount - 1], table[pullCount]);
+  }
+
+  if(complete)
+  {
+    for(int pullCount = 0; pullCount < count - 1; pullCount++)
+    {
+      if(TScalar::CmpD(cdf[pullCount], 1.0) > 0)
+        TScalar::SetD(cdf[pullCount], 1.0);
+    }
+    TScalar::SetD(cdf[count - 1], 1.0);
+  }
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::LookupCDF(const Value* cdf, int count, int pulls)
+{
+  if(pulls <= 0)
+    return 0.0;
+  if(pulls > count)
+    pulls = count;
+  return TScalar::GetD(cdf[pulls - 1]);
+}
+
+template<class TScalar>
+int GNSN_WProbCalcT<TScalar>::SearchQuantile(const Value* cdf, int count, double probability)
+{
+  if(probability <= 0.0)
+    return 0;
+  if(TScalar::CmpD(cdf[count - 1], probability) < 0)
+    return -1;
+
+  // The first pull count with a cumulative probability of at least "probability".
+  int low = 0;
+  int high = count - 1;
+  while(low < high)
+  {
+    int middle = low + (high - low) / 2;
+    if(TScalar::CmpD(cdf[middle], probability) >= 0)
+      high = middle;
+    else
+      low = middle + 1;
+  }
+  return low + 1;
+}
+
+template<class TScalar>
+const typename TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRCharacterCDFTable(int conLevel)
+{
+  if(conLevel < 0 || conLevel >= 7)
+    return nullptr;
+  this->CalcSSRCharacterLevel(conLevel);
+  return this->ProbCDF_SSRChar[conLevel];
+}
+
+template<class TScalar>
+const typename TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRWeaponCDFTable(int refLevel)
+{
+  if(refLevel < 0 || refLevel >= 5)
+    return nullptr;
+  this->CalcSSRWeaponLevel(refLevel);
+  return this->ProbCDF_SSRWeap[refLevel];
+}
+
+template<class TScalar>
+const typename TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRPairCDFTable(int conLevel, int refLevel)
+{
+  if(conLevel < 0 || conLevel >= 7 || refLevel < 0 || refLevel >= 5)
+    return nullptr;
+  this->CalcSSRPairLevel(conLevel, refLevel);
+  return this->ProbCDF_SSRPair[conLevel][refLevel];
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::GetSSRCharacterCDF(int conLevel, int pulls)
+{
+  const Value* cdf = this->GetSSRCharacterCDFTable(conLevel);
+  return cdf ? LookupCDF(cdf, this->CharacterPulls(conLevel), pulls) : 0.0;
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::GetSSRWeaponCDF(int refLevel, int pulls)
+{
+  const Value* cdf = this->GetSSRWeaponCDFTable(refLevel);
+  return cdf ? LookupCDF(cdf, this->WeaponPulls(refLevel), pulls) : 0.0;
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::GetSSRPairCDF(int conLevel, int refLevel, int pulls)
+{
+  const Value* cdf = this->GetSSRPairCDFTable(conLevel, refLevel);
+  return cdf ? LookupCDF(cdf, this->PairPulls(conLevel, refLevel), pulls) : 0.0;
+}
+
+template<class TScalar>
+int GNSN_WProbCalcT<TScalar>::GetSSRCharacterQuantile(int conLevel, double probability)
+{
+  const Value* cdf = this->GetSSRCharacterCDFTable(conLevel);
+  return cdf ? SearchQuantile(cdf, this->CharacterPulls(conLevel), probability) : -1;
+}
+
+template<class TScalar>
+int GNSN_WProbCalcT<TScalar>::GetSSRWeaponQuantile(int refLevel, double probability)
+{
+  const Value* cdf = this->GetSSRWeaponCDFTable(refLevel);
+  return cdf ? SearchQuantile(cdf, this->WeaponPulls(refLevel), probability) : -1;
+}
+
+template<class TScalar>
+int GNSN_WProbCalcT<TScalar>::GetSSRPairQuantile(int conLevel, int refLevel, double probability)
+{
+  const Value* cdf = this->GetSSRPairCDFTable(conLevel, refLevel);
+  return cdf ? SearchQuantile(cdf, this->PairPulls(conLevel, refLevel), probability) : -1;
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::CalcCumulative(const TScalar::Value*, int, bool, TScalar::Value*); \
+  template double GNSN_WProbCalcT<TScalar>::LookupCDF(const TScalar::Value*, int, int); \
+  template int GNSN_WProbCalcT<TScalar>::SearchQuantile(const TScalar::Value*, int, double); \
+  template const TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRCharacterCDFTable(int); \
+  template const TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRWeaponCDFTable(int); \
+  template const TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRPairCDFTable(int, int); \
+  template double GNSN_WProbCalcT<TScalar>::GetSSRCharacterCDF(int, int); \
+  template double GNSN_WProbCalcT<TScalar>::GetSSRWeaponCDF(int, int); \
+  template double GNSN_WProbCalcT<TScalar>::GetSSRPairCDF(int, int, int); \
+  template int GNSN_WProbCalcT<TScalar>::GetSSRCharacterQuantile(int, double); \
+  template int GNSN_WProbCalcT<TScalar>::GetSSRWeaponQuantile(int, double); \
+  template int GNSN_WProbCalcT<TScalar>::GetSSRPairQuantile(int, int, double);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
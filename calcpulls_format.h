@@ -0,0 +1,75 @@
+#pragma once
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include "calcpulls_scalar.h"
+
+// ---- #
+// Text output of tables.
+// Rows are put together in a buffer that is kept between rows, and written to a stream in one "write()" per chunk,
+// --- so formatting a value costs no allocation and no trip through the stream's formatting.
+// Values come out the same as "TScalar::Write()" to a stream set to "std::fixed" and "std::setprecision(digits)".
+// ---- #
+
+template<class TScalar>
+class GNSN_Formatter
+{
+public:
+  typedef typename TScalar::Value Value;
+
+private:
+  std::vector<char> buffer;
+  size_t size = 0;
+  int digits;
+  typename TScalar::FormatScratch scratch;
+
+public:
+  explicit GNSN_Formatter(int digits) : digits(digits) {}
+
+  size_t GetSize() const { return size; }
+  const char* GetData() const { return buffer.data(); }
+  void Clear() { size = 0; }
+
+  void Append(const char* text)
+  {
+    const size_t length = std::strlen(text);
+    std::memcpy(Reserve(length), text, length);
+    size += length;
+  }
+
+  void AppendChar(char c)
+  {
+    *Reserve(1) = c;
+    size++;
+  }
+
+  void AppendInt(int value)
+  {
+    char* start = Reserve(12);
+    size = std::to_chars(start, start + 12, value).ptr - buffer.data();
+  }
+
+  void AppendValue(const Value& value)
+  {
+    const size_t bytes = TScalar::FormatBytes(value, digits);
+    size = TScalar::Format(scratch, Reserve(bytes), value, digits) - buffer.data();
+  }
+
+  // Write everything in the buffer and empty it.
+  void WriteTo(std::ostream& os)
+  {
+    if(size > 0)
+      os.write(buffer.data(), (std::streamsize)size);
+    size = 0;
+  }
+
+private:
+  // Room for "bytes" more characters, returning where they go.
+  char* Reserve(size_t bytes)
+  {
+    if(buffer.size() < size + bytes)
+      buffer.resize((size + bytes) * 2);
+    return buffer.data() + size;
+  }
+};
@@ -0,0 +1,171 @@
+#include <iostream>
+#include <fstream>
+#include <iomanip>
+#include <algorithm>
+#include <mpir.h>
+
+#include "calcpulls.h"
+#include "calcpulls_convolve.h"
+
+// Queries starting from a banner state other than zero pity.
+// The tables for a fresh start already hold every copy after the first,
+// --- so only the first copy (the "head") depends on the state, and the rest is one convolution with a table.
+
+// Store in "result", the probabilities for which pull count the next five-star could occur on, after "pity" pulls without one.
+// Those are the fresh probabilities from "pity" onwards, divided by the part of the population still without a five-star at "pity".
+// Returns false when none of it is left, which the rules rule out past "GetCertainPull()" and rounding may still do before it.
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::CalcSourceDistFromPity(const Value* srcDist, int hardPity, int pity, Value* result)
+{
+  Value remaining;
+  TScalar::Init(remaining, this->precision);
+  TScalar::SetD(remaining, 0.0);
+  for(int pullCount = pity; pullCount < hardPity; pullCount++)
+  {
+    TScalar::Add(remaining, remaining, srcDist[pullCount]);
+  }
+  if(TScalar::CmpD(remaining, 0.0) <= 0)
+  {
+    TScalar::Clear(remaining);
+    return false;
+  }
+  for(int pullCount = pity; pullCount < hardPity; pullCount++)
+  {
+    TScalar::Div(result[pullCount - pity], srcDist[pullCount], remaining);
+  }
+  TScalar::Clear(remaining);
+  return true;
+}
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::CalcSSRCharacterFromState(const GNSN_PullState& state, int conLevel, GNSN_ProbArrayT<TScalar>& result)
+{
+  const int hardPity = this->rules.character.pity.hardPity;
+  if(state.pity < 0 || state.pity > this->rules.character.pity.GetCertainPull() || conLevel < 0 || conLevel >= 7)
+    return false;
+  this->CalcSSRCharacterLevel(conLevel > 0 ? conLevel - 1 : 0);
+
+  GNSN_Arena scratch;
+  Value gA, gB;
+  TScalar::Init(gA, this->precision);
+  TScalar::Init(gB, this->precision);
+
+  // The next five-star.
+  const int srcCount = hardPity - state.pity;
+  Value* srcDist = scratch.AllocateArray<Value>(srcCount);
+  TScalar::InitArray(srcDist, srcCount, this->precision, scratch);
+  if(!this->CalcSourceDistFromPity(this->ProbSrcDist_SSRChar, hardPity, state.pity, srcDist))
+  {
+    TScalar::Clear(gA);
+    TScalar::Clear(gB);
+    return false;
+  }
+
+  // The first copy.
+  // With a guarantee, the next five-star is the specific five-star.
+  // Otherwise, the next five-star is a 50/50, and losing it leaves the five-star after it (from zero pity) guaranteed.
+  const int firstCount = srcCount + hardPity;
+  Value* first = scratch.AllocateArray<Value>(firstCount);
+  TScalar::InitArray(first, firstCount, this->precision, scratch);
+  if(!state.guaranteed)
+  {
+    this->SetRate(gA, this->rules.character.featuredRate); // The probability for winning a 50/50.
+    TScalar::SetD(gB, 1.0);
+    TScalar::Sub(gB, gB, gA);                              // The probability for losing it.
+
+    // Losing it, then the guaranteed five-star.
+    Value* lostDist = scratch.AllocateArray<Value>(srcCount);
+    TScalar::InitArray(lostDist, srcCount, this->precision, scratch);
+    for(int pullCount = 0; pullCount < srcCount; pullCount++)
+    {
+      TScalar::Mul(lostDist[pullCount], srcDist[pullCount], gB);
+    }
+    GNSN_Convolution<TScalar>::Accumulate(first, lostDist, srcCount, this->ProbSrcDist_SSRChar, hardPity, 1, this->precision);
+
+    // Winning it.
+    for(int pullCount = 0; pullCount < srcCount; pullCount++)
+    {
+      TScalar::Mul(srcDist[pullCount], srcDist[pullCount], gA);
+    }
+  }
+  for(int pullCount = 0; pullCount < srcCount; pullCount++)
+  {
+    TScalar::Add(first[pullCount], first[pullCount], srcDist[pullCount]);
+  }
+
+  // The copies after the first.
+  result.Reset(this->CharacterPulls(conLevel), this->precision);
+  if(conLevel == 0)
+  {
+    for(int pullCount = 0; pullCount < firstCount; pullCount++)
+    {
+      TScalar::Set(result[pullCount], first[pullCount]);
+    }
+  }
+  else
+  {
+    this->ConvolveSupported(result.GetValues(), first, FindSupport(first, firstCount), this->ProbPL_SSRChar[conLevel - 1], this->Support_SSRChar[conLevel - 1]);
+  }
+
+  TScalar::Clear(gA);
+  TScalar::Clear(gB);
+  return true;
+}
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::CalcSSRWeaponFromState(const GNSN_PullState& state, int refLevel, GNSN_ProbArrayT<TScalar>& result)
+{
+  const int hardPity = this->rules.weapon.pity.hardPity;
+  const int firstCount = this->WeaponPulls(0);
+  if(state.pity < 0 || state.pity > this->rules.weapon.pity.GetCertainPull() || state.fatePoints < 0 || state.fatePoints > this->rules.weapon.fatePoints || refLevel < 0 || refLevel >= 5)
+    return false;
+  this->CalcSSRWeaponLevel(refLevel > 0 ? refLevel - 1 : 0);
+
+  GNSN_Arena scratch;
+  Value* first = scratch.AllocateArray<Value>(firstCount);
+  TScalar::InitArray(first, firstCount, this->precision, scratch);
+  Value* nextDist = scratch.AllocateArray<Value>(hardPity);
+  TScalar::InitArray(nextDist, hardPity, this->precision, scratch);
+
+  // The next five-star, then the states it leads through (see "CalcSSRWeaponStates()").
+  if(!this->CalcSourceDistFromPity(this->ProbSrcDist_SSRWeap, hardPity, state.pity, nextDist))
+    return false;
+  this->CalcSSRWeaponStates(nextDist, hardPity - state.pity, state.fatePoints, state.guaranteed, first);
+
+  // The copies after the first.
+  result.Reset(this->WeaponPulls(refLevel), this->precision);
+  if(refLevel == 0)
+  {
+    for(int pullCount = 0; pullCount < firstCount; pullCount++)
+    {
+      TScalar::Set(result[pullCount], first[pullCount]);
+    }
+  }
+  else
+  {
+    this->ConvolveSupported(result.GetValues(), first, FindSupport(first, firstCount - state.pity), this->ProbPL_SSRWeap[refLevel - 1], this->Support_SSRWeap[refLevel - 1]);
+  }
+  return true;
+}
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::CalcSSRPairFromState(const GNSN_PullState& charState, const GNSN_PullState& weapState, int conLevel, int refLevel, GNSN_ProbArrayT<TScalar>& result)
+{
+  GNSN_ProbArrayT<TScalar> charResult, weapResult;
+  if(!this->CalcSSRCharacterFromState(charState, conLevel, charResult) || !this->CalcSSRWeaponFromState(weapState, refLevel, weapResult))
+    return false;
+
+  // Pulling for the pair takes pull count A on the character banner plus pull count B on the weapon banner.
+  result.Reset(charResult.GetCount() + weapResult.GetCount(), this->precision);
+  GNSN_Convolution<TScalar>::Accumulate(result.GetValues(), charResult.GetValues(), charResult.GetCount(), weapResult.GetValues(), weapResult.GetCount(), 1, this->precision);
+  return true;
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template bool GNSN_WProbCalcT<TScalar>::CalcSourceDistFromPity(const TScalar::Value*, int, int, TScalar::Value*); \
+  template bool GNSN_WProbCalcT<TScalar>::CalcSSRCharacterFromState(const GNSN_PullState&, int, GNSN_ProbArrayT<TScalar>&); \
+  template bool GNSN_WProbCalcT<TScalar>::CalcSSRWeaponFromState(const GNSN_PullState&, int, GNSN_ProbArrayT<TScalar>&); \
+  template bool GNSN_WProbCalcT<TScalar>::CalcSSRPairFromState(const GNSN_PullState&, const GNSN_PullState&, int, int, GNSN_ProbArrayT<TScalar>&);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
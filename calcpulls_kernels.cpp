@@ -0,0 +1,235 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <vector>
+
+#include "calcpulls_kernels.h"
+
+// Convolution kernels for doubles, see "calcpulls_kernels.h".
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define GNSN_KERNELS_X86 1
+#include <immintrin.h>
+#endif
+
+// ---- #
+// Error-free transformations.
+// "TwoSum()" gives "a + b" and its rounding error, "TwoProduct()" gives "a * b" and its rounding error.
+// ---- #
+
+static inline void TwoSum(double a, double b, double& sum, double& error)
+{
+  sum = a + b;
+  const double z = sum - a;
+  error = (a - (sum - z)) + (b - z);
+}
+
+// "THasFMA" for code built for a CPU with FMA, where it is one instruction.
+// Without it, Dekker's splitting into halves of 26 bits, which is only exact when nothing gets fused into an FMA.
+template<bool THasFMA>
+static inline void TwoProduct(double a, double b, double& product, double& error)
+{
+  product = a * b;
+  if(THasFMA)
+  {
+    error = std::fma(a, b, -product);
+    return;
+  }
+  const double factor = 134217729.0; // 2^27 + 1
+  const double ta = factor * a, tb = factor * b;
+  const double ah = ta - (ta - a), bh = tb - (tb - b);
+  const double al = a - ah, bl = b - bh;
+  error = al * bl - (((product - ah * bh) - al * bh) - ah * bl);
+}
+
+#ifdef FP_FAST_FMA
+static const bool kScalarFMA = true;
+#else
+static const bool kScalarFMA = false;
+#endif
+
+// The rest of a dot product after the vector part, and the rounding of the compensated sum to one double.
+template<bool THasFMA>
+static inline double FinishDot(double sum, double compensation, const double* a, const double* b, int start, int count)
+{
+  for(int index = start; index < count; index++)
+  {
+    double product, productError, sumError;
+    TwoProduct<THasFMA>(a[index], b[index], product, productError);
+    TwoSum(sum, product, sum, sumError);
+    compensation += sumError + productError;
+  }
+  return sum + compensation;
+}
+
+// Add the partial sums and their errors of "laneCount" lanes to "sum" and "compensation".
+static inline void GatherLanes(const double* laneSums, const double* laneErrors, int laneCount, double& sum, double& compensation)
+{
+  for(int lane = 0; lane < laneCount; lane++)
+  {
+    double sumError;
+    TwoSum(sum, laneSums[lane], sum, sumError);
+    compensation += sumError + laneErrors[lane];
+  }
+}
+
+static double DotScalar(double initial, const double* a, const double* b, int count)
+{
+  return FinishDot<kScalarFMA>(initial, 0.0, a, b, 0, count);
+}
+
+
+
+#ifdef GNSN_KERNELS_X86
+
+// ---- #
+// AVX2 and AVX-512, two vectors of lanes each, so the additions of one don't wait on the other.
+// ---- #
+
+__attribute__((target("avx2,fma")))
+static inline void StepAVX2(__m256d x, __m256d y, __m256d& sum, __m256d& compensation)
+{
+  const __m256d product = _mm256_mul_pd(x, y);
+  const __m256d productError = _mm256_fmsub_pd(x, y, product);
+  const __m256d next = _mm256_add_pd(sum, product);
+  const __m256d z = _mm256_sub_pd(next, sum);
+  const __m256d sumError = _mm256_add_pd(_mm256_sub_pd(sum, _mm256_sub_pd(next, z)), _mm256_sub_pd(product, z));
+  compensation = _mm256_add_pd(compensation, _mm256_add_pd(sumError, productError));
+  sum = next;
+}
+
+__attribute__((target("avx2,fma")))
+static double DotAVX2(double initial, const double* a, const double* b, int count)
+{
+  __m256d sum0 = _mm256_setzero_pd(), sum1 = _mm256_setzero_pd();
+  __m256d compensation0 = _mm256_setzero_pd(), compensation1 = _mm256_setzero_pd();
+  int index = 0;
+  for(; index + 8 <= count; index += 8)
+  {
+    StepAVX2(_mm256_loadu_pd(a + index), _mm256_loadu_pd(b + index), sum0, compensation0);
+    StepAVX2(_mm256_loadu_pd(a + index + 4), _mm256_loadu_pd(b + index + 4), sum1, compensation1);
+  }
+
+  alignas(32) double laneSums[8], laneErrors[8];
+  _mm256_store_pd(laneSums, sum0);
+  _mm256_store_pd(laneSums + 4, sum1);
+  _mm256_store_pd(laneErrors, compensation0);
+  _mm256_store_pd(laneErrors + 4, compensation1);
+  double sum = initial, compensation = 0.0;
+  GatherLanes(laneSums, laneErrors, (index > 0) ? 8 : 0, sum, compensation);
+  return FinishDot<true>(sum, compensation, a, b, index, count);
+}
+
+__attribute__((target("avx512f")))
+static inline void StepAVX512(__m512d x, __m512d y, __m512d& sum, __m512d& compensation)
+{
+  const __m512d product = _mm512_mul_pd(x, y);
+  const __m512d productError = _mm512_fmsub_pd(x, y, product);
+  const __m512d next = _mm512_add_pd(sum, product);
+  const __m512d z = _mm512_sub_pd(next, sum);
+  const __m512d sumError = _mm512_add_pd(_mm512_sub_pd(sum, _mm512_sub_pd(next, z)), _mm512_sub_pd(product, z));
+  compensation = _mm512_add_pd(compensation, _mm512_add_pd(sumError, productError));
+  sum = next;
+}
+
+__attribute__((target("avx512f")))
+static double DotAVX512(double initial, const double* a, const double* b, int count)
+{
+  __m512d sum0 = _mm512_setzero_pd(), sum1 = _mm512_setzero_pd();
+  __m512d compensation0 = _mm512_setzero_pd(), compensation1 = _mm512_setzero_pd();
+  int index = 0;
+  for(; index + 16 <= count; index += 16)
+  {
+    StepAVX512(_mm512_loadu_pd(a + index), _mm512_loadu_pd(b + index), sum0, compensation0);
+    StepAVX512(_mm512_loadu_pd(a + index + 8), _mm512_loadu_pd(b + index + 8), sum1, compensation1);
+  }
+
+  alignas(64) double laneSums[16], laneErrors[16];
+  _mm512_store_pd(laneSums, sum0);
+  _mm512_store_pd(laneSums + 8, sum1);
+  _mm512_store_pd(laneErrors, compensation0);
+  _mm512_store_pd(laneErrors + 8, compensation1);
+  double sum = initial, compensation = 0.0;
+  GatherLanes(laneSums, laneErrors, (index > 0) ? 16 : 0, sum, compensation);
+  return FinishDot<true>(sum, compensation, a, b, index, count);
+}
+
+#endif
+
+
+
+// ---- #
+// Dispatch.
+// ---- #
+
+// -1 until the CPU has been asked.
+static std::atomic<int> gnsnKernelLevel{ -1 };
+
+GNSN_DoubleKernels::Level GNSN_DoubleKernels::GetSupportedLevel()
+{
+#ifdef GNSN_KERNELS_X86
+  __builtin_cpu_init();
+  if(__builtin_cpu_supports("avx512f"))
+    return kAVX512;
+  if(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+    return kAVX2;
+#endif
+  return kScalar;
+}
+
+GNSN_DoubleKernels::Level GNSN_DoubleKernels::GetLevel()
+{
+  int level = gnsnKernelLevel.load(std::memory_order_relaxed);
+  if(level < 0)
+  {
+    level = (int)GetSupportedLevel();
+    gnsnKernelLevel.store(level, std::memory_order_relaxed);
+  }
+  return (Level)level;
+}
+
+void GNSN_DoubleKernels::SetLevel(Level level)
+{
+  gnsnKernelLevel.store(std::min((int)level, (int)GetSupportedLevel()), std::memory_order_relaxed);
+}
+
+const char* GNSN_DoubleKernels::GetLevelName(Level level)
+{
+  switch(level)
+  {
+  case kAVX512:
+    return "avx512";
+  case kAVX2:
+    return "avx2";
+  default:
+    return "scalar";
+  }
+}
+
+void GNSN_DoubleKernels::Accumulate(double* target, const double* a, int countA, const double* b, int countB, int offset)
+{
+  if(countA <= 0 || countB <= 0)
+    return;
+
+  double (*dot)(double, const double*, const double*, int) = DotScalar;
+#ifdef GNSN_KERNELS_X86
+  const Level level = GetLevel();
+  if(level == kAVX512)
+    dot = DotAVX512;
+  else if(level == kAVX2)
+    dot = DotAVX2;
+#endif
+
+  // "b" reversed, so output "n" is the dot product of "a[lo..hi]" and "reversed[countB - 1 - n + lo..]".
+  std::vector<double> reversed(b, b + countB);
+  std::reverse(reversed.begin(), reversed.end());
+
+  const int countOut = countA + countB - 1;
+  for(int n = 0; n < countOut; n++)
+  {
+    const int lo = std::max(0, n - (countB - 1));
+    const int hi = std::min(n, countA - 1);
+    double& out = target[n + offset];
+    out = dot(out, a + lo, reversed.data() + (countB - 1 - n + lo), hi - lo + 1);
+  }
+}
\ No newline at end of file
@@ -0,0 +1,38 @@
+#pragma once
+
+// ---- #
+// Convolution kernels for doubles.
+// "target[n + offset] += a[i] * b[j]" for every "i + j = n", worked out one output at a time as a dot product
+// --- of "a" with "b" reversed, so the inner loop reads both tables in order and vectorizes.
+//
+// Each dot product is compensated (Ogita, Rump and Oishi's "Dot2"): every product keeps its rounding error (through FMA,
+// --- or Dekker's splitting without it), and every sum keeps its rounding error (Knuth's TwoSum), and the errors are added back at the end.
+// The result is as accurate as if it were summed with twice the precision of a double and rounded once:
+// --- |result - exact| <= u * |exact| + (n * u)^2 / (1 - n * u)^2 * sum(|a[i] * b[j]|), with u = 2^-53 and "n" products.
+// The tables are probabilities, which are never negative, so the sum of the absolute values is the exact value itself,
+// --- and for tables of a few thousand pull counts each output is within about one rounding (1.2e-16 relative) of the exact
+// --- convolution of its inputs, as the 256 bit MPF calculations would give it.
+// (This needs strict IEEE arithmetic, so the sources must not be built with "-ffast-math".)
+//
+// The kernel is picked when first used, by what the CPU has: AVX-512, AVX2 with FMA, or plain C++ everywhere else.
+// ---- #
+
+class GNSN_DoubleKernels
+{
+public:
+  enum Level
+  {
+    kScalar = 0,
+    kAVX2 = 1,   // AVX2 and FMA, 4 doubles at a time.
+    kAVX512 = 2, // AVX-512F, 8 doubles at a time.
+  };
+
+  static void Accumulate(double* target, const double* a, int countA, const double* b, int countB, int offset);
+
+  // The best level the CPU has, and the level in use.
+  // "SetLevel()" picks a lower level (for comparing the kernels), or the best one again with "kAVX512".
+  static Level GetSupportedLevel();
+  static Level GetLevel();
+  static void SetLevel(Level level);
+  static const char* GetLevelName(Level level);
+};
\ No newline at end of file
@@ -0,0 +1,141 @@
+#include <atomic>
+#include <cstdio>
+
+#include "calcpulls_binary.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <process.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+uint64_t GNSN_HashText(const char* text)
+{
+  uint64_t hash = 14695981039346656037ull;
+  for(; *text != '\0'; text++)
+  {
+    hash ^= (unsigned char)*text;
+    hash *= 1099511628211ull;
+  }
+  return hash;
+}
+
+std::string GNSN_TemporaryPath(const char* path)
+{
+  static std::atomic<unsigned> calls(0);
+#ifdef _WIN32
+  const long process = (long)_getpid();
+#else
+  const long process = (long)getpid();
+#endif
+  return std::string(path) + "." + std::to_string(process) + "." + std::to_string(calls++) + ".tmp";
+}
+
+bool GNSN_ReplaceFile(const char* from, const char* to)
+{
+#ifdef _WIN32
+  // Fails while "to" is mapped, by this process or any other, rather than changing it under the mapping.
+  const bool replaced = MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+  // The mappings of the old file keep its inode.
+  const bool replaced = std::rename(from, to) == 0;
+#endif
+  if(!replaced)
+    std::remove(from);
+  return replaced;
+}
+
+#ifdef _WIN32
+
+bool GNSN_MappedFile::Open(const char* path)
+{
+  Close();
+
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if(file == INVALID_HANDLE_VALUE)
+    return false;
+
+  LARGE_INTEGER fileSize;
+  if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+  if(mapping == nullptr)
+  {
+    CloseHandle(file);
+    return false;
+  }
+
+  void* view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+  if(view == nullptr)
+  {
+    CloseHandle(mapping);
+    CloseHandle(file);
+    return false;
+  }
+
+  this->fileHandle = file;
+  this->mappingHandle = mapping;
+  this->data = static_cast<char*>(view);
+  this->size = (size_t)fileSize.QuadPart;
+  return true;
+}
+
+void GNSN_MappedFile::Close()
+{
+  if(this->data != nullptr)
+    UnmapViewOfFile(this->data);
+  if(this->mappingHandle != nullptr)
+    CloseHandle((HANDLE)this->mappingHandle);
+  if(this->fileHandle != nullptr)
+    CloseHandle((HANDLE)this->fileHandle);
+  this->data = nullptr;
+  this->size = 0;
+  this->fileHandle = nullptr;
+  this->mappingHandle = nullptr;
+}
+
+#else
+
+bool GNSN_MappedFile::Open(const char* path)
+{
+  Close();
+
+  int file = open(path, O_RDONLY);
+  if(file < 0)
+    return false;
+
+  struct stat status;
+  if(fstat(file, &status) != 0 || status.st_size == 0)
+  {
+    close(file);
+    return false;
+  }
+
+  // Private and writable, so the tables can be used like any others without ever changing the file.
+  void* view = mmap(nullptr, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, file, 0);
+  close(file);
+  if(view == MAP_FAILED)
+    return false;
+
+  this->data = static_cast<char*>(view);
+  this->size = (size_t)status.st_size;
+  return true;
+}
+
+void GNSN_MappedFile::Close()
+{
+  if(this->data != nullptr)
+    munmap(this->data, this->size);
+  this->data = nullptr;
+  this->size = 0;
+}
+
+#endif
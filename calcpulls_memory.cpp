@@ -2,192 +2,239 @@
 #include <fstream>
 #include <iomanip>
 #include "calcpulls.h"
+#include "calcpulls_format.h"
 
-void GNSN_WProbCalc::Initialize()
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::Initialize()
 {
 }
 
-void GNSN_WProbCalc::OutputDebug()
+template<class TScalar>
+template<class TFormatRow>
+void GNSN_WProbCalcT<TScalar>::WriteRows(const char* path, int rowCount, const TFormatRow& formatRow)
 {
-  // Output some information for characters.
-  std::ofstream ofs;
-  if((initialized & 1) == 1)
+  const int rowsPerChunk = 128;
+  const int chunkCount = (rowCount + rowsPerChunk - 1) / rowsPerChunk;
+  std::ofstream ofs(path, std::ofstream::out | std::ofstream::trunc);
+
+  if(this->threadCount <= 1)
   {
-    ofs.open("GNSN_WProbCalc - Debug - Character Probabilities.txt", std::ofstream::out | std::ofstream::trunc);
-    for(int pullCount = 0; pullCount < 90; pullCount++)
+    GNSN_Formatter<TScalar> formatter(this->outputDigits);
+    for(int chunk = 0; chunk < chunkCount; chunk++)
     {
-      ofs << pullCount
-        << std::fixed << std::setprecision(24)
-        << "\t" << this->ProbSrc_SSRChar[pullCount] << "\n";
+      for(int row = chunk * rowsPerChunk; row < rowCount && row < (chunk + 1) * rowsPerChunk; row++)
+        formatRow(formatter, row);
+      formatter.WriteTo(ofs);
     }
-    ofs << "\n\n\n";
-    for(int pullCount = 0; pullCount < 90; pullCount++)
+  }
+  else
+  {
+    if(!this->threadPool)
+      this->threadPool.reset(new GNSN_ThreadPool(this->threadCount));
+
+    // A few chunks per thread at a time, so the buffers stay small however long the file is.
+    const int chunksPerRound = this->threadCount * 4;
+    std::vector<GNSN_Formatter<TScalar>> formatters(chunksPerRound, GNSN_Formatter<TScalar>(this->outputDigits));
+    for(int firstChunk = 0; firstChunk < chunkCount; firstChunk += chunksPerRound)
     {
-      ofs << pullCount
-        << std::fixed << std::setprecision(24)
-        << "\t" << this->ProbSrcDist_SSRChar[pullCount] << "\n";
+      const int roundChunks = (chunkCount - firstChunk < chunksPerRound) ? chunkCount - firstChunk : chunksPerRound;
+      this->threadPool->Run(roundChunks, [&](int task) {
+        const int chunk = firstChunk + task;
+        for(int row = chunk * rowsPerChunk; row < rowCount && row < (chunk + 1) * rowsPerChunk; row++)
+          formatRow(formatters[task], row);
+      });
+      for(int task = 0; task < roundChunks; task++)
+        formatters[task].WriteTo(ofs);
     }
-    ofs.close();
+  }
+  ofs.close();
+}
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::OutputDebug()
+{
+  this->MarkPhase("output.debug", true);
+
+  // Output some information for characters.
+  // Each file has the probabilities per pull count, three empty lines, then the distribution per pull count.
+  if((initialized & 1) == 1)
+  {
+    const int hardPity = this->rules.character.pity.hardPity;
+    this->WriteRows("GNSN_WProbCalc - Debug - Character Probabilities.txt", 2 * hardPity, [this, hardPity](GNSN_Formatter<TScalar>& out, int row) {
+      if(row == hardPity)
+        out.Append("\n\n\n");
+      out.AppendInt(row % hardPity);
+      out.AppendChar('\t');
+      out.AppendValue(row < hardPity ? this->ProbSrc_SSRChar[row] : this->ProbSrcDist_SSRChar[row - hardPity]);
+      out.AppendChar('\n');
+    });
   }
 
 
   // Output some information for weapons.
   if((initialized & 2) == 2)
   {
-    ofs.open("GNSN_WProbCalc - Debug - Weapon Probabilities.txt", std::ofstream::out | std::ofstream::trunc);
-    for(int pullCount = 0; pullCount < 80; pullCount++)
-    {
-      ofs << pullCount
-        << std::fixed << std::setprecision(24)
-        << "\t" << this->ProbSrc_SSRWeap[pullCount] << "\n";
-    }
-    ofs << "\n\n\n";
-    for(int pullCount = 0; pullCount < 80; pullCount++)
-    {
-      ofs << pullCount
-        << std::fixed << std::setprecision(24)
-        << "\t" << this->ProbSrcDist_SSRWeap[pullCount] << "\n";
-    }
-    ofs.close();
+    const int hardPity = this->rules.weapon.pity.hardPity;
+    this->WriteRows("GNSN_WProbCalc - Debug - Weapon Probabilities.txt", 2 * hardPity, [this, hardPity](GNSN_Formatter<TScalar>& out, int row) {
+      if(row == hardPity)
+        out.Append("\n\n\n");
+      out.AppendInt(row % hardPity);
+      out.AppendChar('\t');
+      out.AppendValue(row < hardPity ? this->ProbSrc_SSRWeap[row] : this->ProbSrcDist_SSRWeap[row - hardPity]);
+      out.AppendChar('\n');
+    });
   }
+
+  this->MarkPhase("output.debug", false);
 }
 
-void GNSN_WProbCalc::OutputResults()
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::OutputResults()
 {
+  this->MarkPhase("output.results", true);
+
   // Output results for characters.
-  std::ofstream ofs;
+  // Each file has a row per pull count, up to the most pulls its longest table has.
   if((initialized & 1) == 1)
   {
-    ofs.open("GNSN_WProbCalc - Results - SSR Character Probabilities.txt", std::ofstream::out | std::ofstream::trunc);
-    for(int pullCount = 0; pullCount < 1260; pullCount++)
-    {
-      ofs << (pullCount + 1);
+    this->WriteRows("GNSN_WProbCalc - Results - SSR Character Probabilities.txt", this->CharacterPulls(6), [this](GNSN_Formatter<TScalar>& out, int pullCount) {
+      out.AppendInt(pullCount + 1);
       for(int conLevel = 0; conLevel < 7; conLevel++)
       {
-        ofs << "\t";
-        if(pullCount < (conLevel + 1) * 180)
-        {
-          ofs
-            << std::fixed
-            << std::setprecision(24)
-            << this->ProbPL_SSRChar[conLevel][pullCount];
-        }
+        out.AppendChar('\t');
+        if(pullCount < this->CharacterPulls(conLevel))
+          out.AppendValue(this->ProbPL_SSRChar[conLevel][pullCount]);
       }
-      ofs << "\n";
-    }
-    ofs.close();
+      out.AppendChar('\n');
+    });
   }
 
 
   // Output results for weapons.
   if((initialized & 2) == 2)
   {
-    ofs.open("GNSN_WProbCalc - Results - SSR Weapon Probabilities.txt", std::ofstream::out | std::ofstream::trunc);
-    for(int pullCount = 0; pullCount < 1200; pullCount++)
-    {
-      ofs << (pullCount + 1);
+    this->WriteRows("GNSN_WProbCalc - Results - SSR Weapon Probabilities.txt", this->WeaponPulls(4), [this](GNSN_Formatter<TScalar>& out, int pullCount) {
+      out.AppendInt(pullCount + 1);
       for(int refineLevel = 0; refineLevel < 5; refineLevel++)
       {
-        ofs << "\t";
-        if(pullCount < (refineLevel + 1) * 240)
-        {
-          ofs
-            << std::fixed
-            << std::setprecision(24)
-            << this->ProbPL_SSRWeap[refineLevel][pullCount];
-        }
+        out.AppendChar('\t');
+        if(pullCount < this->WeaponPulls(refineLevel))
+          out.AppendValue(this->ProbPL_SSRWeap[refineLevel][pullCount]);
       }
-      ofs << "\n";
-    }
-    ofs.close();
+      out.AppendChar('\n');
+    });
   }
 
   if((initialized & 4) == 4)
   {
-    ofs.open("GNSN_WProbCalc - Results - SSR Pair Probabilities.txt", std::ofstream::out | std::ofstream::trunc);
-    for(int pullCount = 0; pullCount < 2460; pullCount++)
-    {
-      ofs << (pullCount + 1);
+    this->WriteRows("GNSN_WProbCalc - Results - SSR Pair Probabilities.txt", this->PairPulls(6, 4), [this](GNSN_Formatter<TScalar>& out, int pullCount) {
+      out.AppendInt(pullCount + 1);
       for(int conLevel = 0; conLevel < 7; conLevel++)
       {
         for(int refineLevel = 0; refineLevel < 5; refineLevel++)
         {
-          ofs << "\t";
-          if(pullCount < (conLevel + 1) * 180 + (refineLevel + 1) * 240)
-          {
-            ofs
-              << std::fixed
-              << std::setprecision(24)
-              << this->ProbPL_SSRPair[conLevel][refineLevel][pullCount];
-          }
+          out.AppendChar('\t');
+          if(pullCount < this->PairPulls(conLevel, refineLevel))
+            out.AppendValue(this->ProbPL_SSRPair[conLevel][refineLevel][pullCount]);
         }
       }
-      ofs << "\n";
-    }
-    ofs.close();
+      out.AppendChar('\n');
+    });
   }
+
+  this->MarkPhase("output.results", false);
 }
 
-void GNSN_WProbCalc::Clean()
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::Clean()
 {
-  // Clean memory for character probabilities.
-  if((initialized & 1) == 1)
-  {
-    for(int i = 0; i < 90; i++)
-    {
-      mpf_clear(this->ProbSrc_SSRChar[i]);
-      mpf_clear(this->ProbSrcDist_SSRChar[i]);
-    }
-    for(int a = 0; a < 7; a++)
-    {
-      for(int b = 0; b < (a + 1) * 180; b++)
-      {
-        mpf_clear(this->ProbPL_SSRChar[a][b]);
-      }
-      delete[] this->ProbPL_SSRChar[a];
-    }
+  this->MarkPhase("clean", true);
 
-    initialized = initialized ^ 1;
-  }
+  this->CleanSSRCharacter();
+  this->CleanSSRWeapon();
+  this->CleanSSRPair();
 
-  // Clean memory for weapon probabilities.
-  if((initialized & 2) == 2)
-  {
-    for(int i = 0; i < 80; i++)
-    {
-      mpf_clear(this->ProbSrc_SSRWeap[i]);
-      mpf_clear(this->ProbSrcDist_SSRWeap[i]);
-    }
-    for(int a = 0; a < 5; a++)
-    {
-      for(int b = 0; b < (a + 1) * 160; b++)
-      {
-        mpf_clear(this->ProbPL_SSRWeap[a][b]);
-      }
-      delete[] this->ProbPL_SSRWeap[a];
-    }
+  // Tables loaded from a file point into it, so it can only go after all of them.
+  this->mappedTables.reset();
 
-    initialized = initialized ^ 2;
+  initialized = 0;
+
+  this->MarkPhase("clean", false);
+}
+
+// Clean memory for character probabilities.
+// Every table of a kind lives in one arena, so releasing the arena frees all of them at once.
+// Levels calculated on their own are in there too, without "initialized" being set.
+// The source tables have an arena of their own, which "keepSource" leaves for the next rules with the same pity rules.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CleanSSRCharacter(bool keepSource)
+{
+  this->spectraSSRChar.Clear();
+  if((initialized & 1) == 1 || this->levelsSSRChar != 0)
+  {
+    this->arenaSSRChar.Release();
+    initialized = initialized & ~1;
+    this->levelsSSRChar = 0;
   }
+  if(!keepSource && (this->sourcesSSR & 1) == 1)
+  {
+    this->arenaSrcSSRChar.Release();
+    this->sourcesSSR = this->sourcesSSR & ~1;
+  }
+}
 
-  // Clean memory for probabilities of combined character and weapon duplicate levels.
-  if((initialized & 4) == 4)
+// Clean memory for weapon probabilities.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CleanSSRWeapon(bool keepSource)
+{
+  this->spectraSSRWeap.Clear();
+  if((initialized & 2) == 2 || this->levelsSSRWeap != 0)
   {
-    for(int conLevel = 0; conLevel < 7; conLevel++)
-    {
-      for(int refLevel = 0; refLevel < 5; refLevel++)
-      {
-        int maxPulls = (conLevel + 1) * 180 + (refLevel + 1) * 240;
-        for(int pullCount = 0; pullCount < maxPulls; pullCount++)
-        {
-          mpf_clear(this->ProbPL_SSRPair[conLevel][refLevel][pullCount]);
-        }
-        delete[] this->ProbPL_SSRPair[conLevel][refLevel];
-      }
-    }
+    this->arenaSSRWeap.Release();
+    initialized = initialized & ~2;
+    this->levelsSSRWeap = 0;
+  }
+  if(!keepSource && (this->sourcesSSR & 2) == 2)
+  {
+    this->arenaSrcSSRWeap.Release();
+    this->sourcesSSR = this->sourcesSSR & ~2;
+  }
+}
 
-    initialized = initialized ^ 4;
+// Clean memory for probabilities of combined character and weapon duplicate levels.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CleanSSRPair()
+{
+  if((initialized & 4) == 4 || this->cellsSSRPair != 0)
+  {
+    this->arenaSSRPair.Release();
+    initialized = initialized & ~4;
+    this->cellsSSRPair = 0;
   }
+}
 
-  initialized = 0;
-}
\ No newline at end of file
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::SetThreadCount(int threadCount)
+{
+  if(threadCount <= 0)
+    threadCount = GNSN_ThreadPool::HardwareThreads();
+  if(threadCount == this->threadCount)
+    return;
+
+  // The pool gets made again with the new count when it's needed.
+  this->threadCount = threadCount;
+  this->threadPool.reset();
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::Initialize(); \
+  template void GNSN_WProbCalcT<TScalar>::OutputDebug(); \
+  template void GNSN_WProbCalcT<TScalar>::OutputResults(); \
+  template void GNSN_WProbCalcT<TScalar>::Clean(); \
+  template void GNSN_WProbCalcT<TScalar>::CleanSSRCharacter(bool); \
+  template void GNSN_WProbCalcT<TScalar>::CleanSSRWeapon(bool); \
+  template void GNSN_WProbCalcT<TScalar>::CleanSSRPair(); \
+  template void GNSN_WProbCalcT<TScalar>::SetThreadCount(int);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
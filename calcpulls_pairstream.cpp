@@ -0,0 +1,162 @@
+#include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <mpir.h>
+
+#include "calcpulls.h"
+#include "calcpulls_convolve.h"
+#include "calcpulls_format.h"
+
+// Pair tables streamed in blocks of rows, without keeping any pair table.
+// Output "t" of a cell (pull count - 1) is the sum of character "i" times weapon "t - 1 - i",
+// --- so a block of rows only needs the weapon values within a block's length of the character values it's paired with.
+// The character table is cut into chunks of the block's length, and each chunk is convolved with the part of the weapon table
+// --- that lands in the block, which is at most twice as long, keeping the outputs inside the block.
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::StreamSSRPair(int blockRows, const PairRowSink& sink)
+{
+  if(blockRows < 1)
+    return false;
+
+  // Make sure dependencies are there.
+  this->CalcSSRCharacter();
+  this->CalcSSRWeapon();
+
+  this->MarkPhase("pair.stream", true);
+
+  // The rows of a block and what each cell works them out in, all made before any thread starts, since the arena isn't shared.
+  // Each cell has a column for its block, three blocks' length for the convolution of one chunk, and its running sum.
+  GNSN_Arena scratch;
+  const int cellCount = 7 * 5;
+  Value* probabilities = scratch.AllocateArray<Value>((size_t)cellCount * blockRows);
+  TScalar::InitArray(probabilities, cellCount * blockRows, this->precision, scratch);
+  Value* cumulative = scratch.AllocateArray<Value>((size_t)cellCount * blockRows);
+  TScalar::InitArray(cumulative, cellCount * blockRows, this->precision, scratch);
+  const int cellScratch = 4 * blockRows + 1;
+  Value* cells = scratch.AllocateArray<Value>((size_t)cellCount * cellScratch);
+  TScalar::InitArray(cells, cellCount * cellScratch, this->precision, scratch);
+  for(int index = 0; index < cellCount * cellScratch; index++)
+    TScalar::SetD(cells[index], 0.0);
+
+  if(this->threadCount != 1 && !this->threadPool)
+    this->threadPool.reset(new GNSN_ThreadPool(this->threadCount));
+
+  const int rowCount = this->PairPulls(6, 4);
+  for(int firstPull = 0; firstPull < rowCount; firstPull += blockRows)
+  {
+    const int blockCount = std::min(blockRows, rowCount - firstPull);
+    auto streamCell = [&](int cell) {
+      Value* work = cells + (size_t)cell * cellScratch;
+      Value& sum = work[4 * blockRows];
+      const int conLevel = cell / 5;
+      const int refLevel = cell % 5;
+      this->StreamSSRPairCell(conLevel, refLevel, firstPull, blockCount, blockRows, work, work + blockRows);
+
+      // Cumulative probabilities, carried on from the block before.
+      // Like "CalcCumulative()", a cell made from whole tables ends at exactly 1 and never passes it.
+      const bool complete = this->Support_SSRChar[conLevel].discarded == 0.0 && this->Support_SSRWeap[refLevel].discarded == 0.0;
+      const int lastPull = this->PairPulls(conLevel, refLevel) - 1;
+      for(int row = 0; row < blockCount; row++)
+      {
+        TScalar::Add(sum, sum, work[row]);
+        if(complete && (firstPull + row == lastPull || TScalar::CmpD(sum, 1.0) > 0))
+          TScalar::SetD(sum, 1.0);
+        TScalar::Set(probabilities[row * cellCount + cell], work[row]);
+        TScalar::Set(cumulative[row * cellCount + cell], sum);
+        TScalar::SetD(work[row], 0.0);
+      }
+    };
+
+    // Every cell of a block is independent of the others.
+    if(this->threadCount == 1)
+    {
+      for(int cell = 0; cell < cellCount; cell++)
+        streamCell(cell);
+    }
+    else
+    {
+      this->threadPool->Run(cellCount, streamCell);
+    }
+    sink(firstPull, blockCount, probabilities, cumulative);
+  }
+
+  this->MarkPhase("pair.stream", false);
+  return true;
+}
+
+// Add rows "firstPull" to "firstPull + rowCount - 1" of a pair cell to "column".
+// "chunk" has room for three times "blockRows" values.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::StreamSSRPairCell(int conLevel, int refLevel, int firstPull, int rowCount, int blockRows, Value* column, Value* chunk)
+{
+  const Value* character = this->ProbPL_SSRChar[conLevel];
+  const Value* weapon = this->ProbPL_SSRWeap[refLevel];
+  const GNSN_TableSupport& supportA = this->Support_SSRChar[conLevel];
+  const GNSN_TableSupport& supportB = this->Support_SSRWeap[refLevel];
+  const int lastPull = firstPull + rowCount - 1;
+
+  for(int firstA = supportA.lo; firstA <= supportA.hi; firstA += blockRows)
+  {
+    const int lastA = std::min(firstA + blockRows - 1, supportA.hi);
+    const int firstB = std::max(supportB.lo, firstPull - 1 - lastA);
+    const int lastB = std::min(supportB.hi, lastPull - 1 - firstA);
+    if(firstB > lastB)
+      continue;
+
+    const int countA = lastA - firstA + 1;
+    const int countB = lastB - firstB + 1;
+    const int countOut = countA + countB - 1;
+    for(int index = 0; index < countOut; index++)
+      TScalar::SetD(chunk[index], 0.0);
+    GNSN_Convolution<TScalar>::Accumulate(chunk, character + firstA, countA, weapon + firstB, countB, 0, this->precision);
+
+    // Output "index" of the chunk is pull count "index + firstA + firstB + 1" - 1.
+    const int lo = std::max(0, firstPull - (firstA + firstB + 1));
+    const int hi = std::min(countOut - 1, lastPull - (firstA + firstB + 1));
+    for(int index = lo; index <= hi; index++)
+    {
+      Value& tarMemAdd = column[index + firstA + firstB + 1 - firstPull];
+      TScalar::Add(tarMemAdd, tarMemAdd, chunk[index]);
+    }
+  }
+}
+
+template<class TScalar>
+bool GNSN_WProbCalcT<TScalar>::OutputSSRPairStream(int blockRows)
+{
+  if(blockRows < 1)
+    return false;
+
+  // The same file as "OutputResults()" writes for the pair tables.
+  std::ofstream ofs("GNSN_WProbCalc - Results - SSR Pair Probabilities.txt", std::ofstream::out | std::ofstream::trunc);
+  GNSN_Formatter<TScalar> formatter(this->outputDigits);
+  this->StreamSSRPair(blockRows, [&](int firstPull, int rowCount, const Value* probabilities, const Value*) {
+    for(int row = 0; row < rowCount; row++)
+    {
+      const int pullCount = firstPull + row;
+      formatter.AppendInt(pullCount + 1);
+      for(int conLevel = 0; conLevel < 7; conLevel++)
+      {
+        for(int refineLevel = 0; refineLevel < 5; refineLevel++)
+        {
+          formatter.AppendChar('\t');
+          if(pullCount < this->PairPulls(conLevel, refineLevel))
+            formatter.AppendValue(probabilities[row * 7 * 5 + conLevel * 5 + refineLevel]);
+        }
+      }
+      formatter.AppendChar('\n');
+    }
+    formatter.WriteTo(ofs);
+  });
+  ofs.close();
+  return true;
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template bool GNSN_WProbCalcT<TScalar>::StreamSSRPair(int, const PairRowSink&); \
+  template void GNSN_WProbCalcT<TScalar>::StreamSSRPairCell(int, int, int, int, int, TScalar::Value*, TScalar::Value*); \
+  template bool GNSN_WProbCalcT<TScalar>::OutputSSRPairStream(int);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
@@ -0,0 +1,125 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "calcpulls_planner.h"
+
+// Pull budget planner, see "calcpulls_planner.h".
+
+template<class TScalar>
+void GNSN_PullPlanner::Build(GNSN_WProbCalcT<TScalar>& calc, int threadCount)
+{
+  const GNSN_BannerRules& rules = calc.GetBannerRules();
+  const int charStride = rules.character.GetStride();
+  const int weapStride = rules.weapon.GetStride();
+
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    const typename TScalar::Value* cdf = calc.GetSSRCharacterCDFTable(conLevel);
+    const int count = (conLevel + 1) * charStride;
+    this->characterCDF[conLevel].assign(count + 1, 0.0);
+    for(int pullCount = 1; pullCount <= count; pullCount++)
+      this->characterCDF[conLevel][pullCount] = TScalar::GetD(cdf[pullCount - 1]);
+  }
+  for(int refLevel = 0; refLevel < 5; refLevel++)
+  {
+    const typename TScalar::Value* cdf = calc.GetSSRWeaponCDFTable(refLevel);
+    const int count = (refLevel + 1) * weapStride;
+    this->weaponCDF[refLevel].assign(count + 1, 0.0);
+    for(int pullCount = 1; pullCount <= count; pullCount++)
+      this->weaponCDF[refLevel][pullCount] = TScalar::GetD(cdf[pullCount - 1]);
+  }
+
+  // The highest levels have the longest tables, so they go first.
+  GNSN_ThreadPool pool(threadCount);
+  pool.Run(7 * 5, [&](int task) {
+    const int target = 7 * 5 - 1 - task;
+    this->Plan(target / 5, target % 5);
+  });
+}
+
+void GNSN_PullPlanner::Plan(int conLevel, int refLevel)
+{
+  const std::vector<double>& character = this->characterCDF[conLevel];
+  const std::vector<double>& weapon = this->weaponCDF[refLevel];
+  const int charCount = (int)character.size() - 1;
+  const int weapCount = (int)weapon.size() - 1;
+
+  // Each level takes at least one pull per copy, and past the end of its table, a banner only wastes pulls.
+  const int charFirst = conLevel + 1;
+  const int weapFirst = refLevel + 1;
+
+  std::vector<GNSN_PullSplit>& plan = this->plans[conLevel][refLevel];
+  plan.assign(charCount + weapCount + 1, GNSN_PullSplit());
+  for(int budget = 0; budget <= charCount + weapCount; budget++)
+  {
+    GNSN_PullSplit& best = plan[budget];
+    best.characterPulls = std::min(budget, charCount);
+    best.weaponPulls = budget - best.characterPulls;
+
+    const int last = std::min(charCount, budget - weapFirst);
+    for(int charPulls = charFirst; charPulls <= last; charPulls++)
+    {
+      const int weapPulls = std::min(budget - charPulls, weapCount);
+      const double probability = character[charPulls] * weapon[weapPulls];
+      if(probability > best.probability)
+      {
+        best.characterPulls = charPulls;
+        best.weaponPulls = budget - charPulls;
+        best.probability = probability;
+      }
+    }
+  }
+}
+
+int GNSN_PullPlanner::GetMaxBudget(int conLevel, int refLevel) const
+{
+  if(conLevel < 0 || conLevel >= 7 || refLevel < 0 || refLevel >= 5)
+    return -1;
+  return (int)this->plans[conLevel][refLevel].size() - 1;
+}
+
+GNSN_PullSplit GNSN_PullPlanner::GetSplit(int conLevel, int refLevel, int budget) const
+{
+  if(conLevel < 0 || conLevel >= 7 || refLevel < 0 || refLevel >= 5)
+    return GNSN_PullSplit();
+  const std::vector<GNSN_PullSplit>& plan = this->plans[conLevel][refLevel];
+  if(plan.empty() || budget < 0)
+    return GNSN_PullSplit();
+  if(budget < (int)plan.size())
+    return plan[budget];
+
+  GNSN_PullSplit split = plan.back();
+  split.weaponPulls += budget - ((int)plan.size() - 1);
+  return split;
+}
+
+int GNSN_PullPlanner::GetBudget(int conLevel, int refLevel, double probability) const
+{
+  if(conLevel < 0 || conLevel >= 7 || refLevel < 0 || refLevel >= 5)
+    return -1;
+  const std::vector<GNSN_PullSplit>& plan = this->plans[conLevel][refLevel];
+  if(probability <= 0.0)
+    return 0;
+  if(plan.empty() || plan.back().probability < probability)
+    return -1;
+  const std::vector<GNSN_PullSplit>::const_iterator found = std::lower_bound(plan.begin(), plan.end(), probability,
+    [](const GNSN_PullSplit& split, double value) { return split.probability < value; });
+  return (int)(found - plan.begin());
+}
+
+void GNSN_PullPlanner::Write(std::ostream& os, int conLevel, int refLevel, int digits) const
+{
+  if(conLevel < 0 || conLevel >= 7 || refLevel < 0 || refLevel >= 5)
+    return;
+  const std::vector<GNSN_PullSplit>& plan = this->plans[conLevel][refLevel];
+  os << std::fixed << std::setprecision(digits);
+  for(int budget = 0; budget < (int)plan.size(); budget++)
+    os << budget << "\t" << plan[budget].characterPulls << "\t" << plan[budget].weaponPulls << "\t" << plan[budget].probability << "\n";
+}
+
+
+
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_PullPlanner::Build<TScalar>(GNSN_WProbCalcT<TScalar>&, int);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
@@ -0,0 +1,60 @@
+#pragma once
+#include <ostream>
+#include <vector>
+
+#include "calcpulls.h"
+
+// ---- #
+// Pull budget planner.
+// A budget of "budget" pulls split ahead of time, "characterPulls" on the character banner and the rest on the weapon banner,
+// --- reaches a constellation and refinement level with CDF_character(characterPulls) * CDF_weapon(budget - characterPulls),
+// --- since the banners are pulled on independently. The planner finds the best split of every budget for every target at once.
+// (Splitting as you go, pulling the weapon banner with whatever the character banner left over, does better,
+// --- and that chance is the pair CDF. The plan is for pulls that must be split beforehand, like banners of different patches.)
+//
+// The CDFs are the calculator's prefix sums of the probability tables, copied as doubles
+// --- (so they end at 1, or short of it by what the error budget trimmed, see "CalcCumulative()").
+// A budget only tries the splits where both CDFs can be above 0 and the character banner is within its table,
+// --- and the targets are tasks on "GNSN_ThreadPool", the longest first.
+// Once built, nothing here changes, so any number of threads may read the plans at once.
+// ---- #
+
+struct GNSN_PullSplit
+{
+  int characterPulls = 0;
+  int weaponPulls = 0;
+  double probability = 0.0; // Chance to reach the target with this split.
+};
+
+class GNSN_PullPlanner
+{
+private:
+  std::vector<double> characterCDF[7];      // Indexed by pull count, so the first value is 0 pulls.
+  std::vector<double> weaponCDF[5];
+  std::vector<GNSN_PullSplit> plans[7][5]; // Indexed by budget, up to the budget that completes both tables.
+
+public:
+  // Calculates whatever the calculator doesn't have yet, then plans every target.
+  // "threadCount" counts the calling thread, and 0 means one per hardware thread.
+  template<class TScalar>
+  void Build(GNSN_WProbCalcT<TScalar>& calc, int threadCount = 0);
+
+  // The budget that completes both tables, from which the best split of a target is certain to reach it
+  // --- (unless the error budget trimmed the tables, which then fall short by what was trimmed). -1 for a level out of range.
+  int GetMaxBudget(int conLevel, int refLevel) const;
+
+  // The best split of "budget" pulls for a target. Budgets past "GetMaxBudget()" get its split, with the rest on the weapon banner.
+  // A level out of range gets an empty split, with a probability of 0.
+  GNSN_PullSplit GetSplit(int conLevel, int refLevel, int budget) const;
+
+  // The fewest pulls with a split reaching a target with at least "probability", or -1 if none does or for a level out of range.
+  // A bigger budget never has a worse best split, so this is a binary search.
+  int GetBudget(int conLevel, int refLevel, double probability) const;
+
+  // The plan of a target, one line per budget: the budget, the character and weapon pulls, and the probability, tab separated.
+  // Writes nothing for a level out of range.
+  void Write(std::ostream& os, int conLevel, int refLevel, int digits = 12) const;
+
+private:
+  void Plan(int conLevel, int refLevel);
+};
\ No newline at end of file
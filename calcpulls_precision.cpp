@@ -0,0 +1,392 @@
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <mpir.h>
+
+#include "calcpulls.h"
+
+// Working precision, and spot checks against exact rationals.
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::SetPrecision(unsigned long bits)
+{
+  if(bits < 64)
+    bits = 64;
+  if(bits == this->precision)
+    return;
+
+  this->Clean();
+  this->precision = bits;
+}
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::SetOutputDigits(int digits)
+{
+  this->outputDigits = (digits < 0) ? 0 : digits;
+}
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::SetAdaptivePrecision(int digits)
+{
+  this->SetOutputDigits(digits);
+  this->SetPrecision(this->GetRequiredPrecision(this->outputDigits));
+}
+
+// Each rounding is at most 2^(1 - bits), and the worst table value takes "ErrorGrowth()" of them.
+// That has to stay below half a unit in the last digit, with 8 bits to spare,
+// --- so the printed digits match the ones from a higher precision unless a value lies right between two outputs.
+template<class TScalar>
+unsigned long GNSN_WProbCalcT<TScalar>::GetRequiredPrecision(int digits) const
+{
+  const double digitBits = (digits < 0 ? 0 : digits) * std::log2(10.0) + 1.0;
+  const double bits = 1.0 + std::log2(this->ErrorGrowth()) + digitBits + 8.0;
+  return std::max(64ul, (unsigned long)std::ceil(bits));
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::GetErrorBound() const
+{
+  return this->ErrorGrowth() * std::ldexp(1.0, 1 - (int)TScalar::MantissaBits(this->precision));
+}
+
+// Every table holds probabilities that sum to at most 1,
+// --- so a value summed from products of two tables picks up at most the worst error of each of them,
+// --- plus a rounding for every product and every add of the sum.
+// The split FFT convolution only truncates 32 bits below the precision, which this leaves room for.
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::ErrorGrowth() const
+{
+  const double charHardPity = this->rules.character.pity.hardPity;
+  const double weapHardPity = this->rules.weapon.pity.hardPity;
+
+  // A few roundings for each rate, and the remaining population picks up a few more per pull, which the distribution inherits.
+  const double charDist = 6.0 * (charHardPity + 1.0);
+  const double weapDist = 6.0 * (weapHardPity + 1.0);
+
+  // The first copy sums products of two distributions (characters), or of one per five-star up to the fate points (weapons),
+  // --- where every five-star past the first is one more convolution with the distribution and a few roundings for its rates.
+  const double charFirst = 3.0 * charDist + 2.0 * (charHardPity + 2.0);
+  const double weapFirst = (this->rules.weapon.fatePoints + 1.0) * (weapDist + 2.0 * (weapHardPity + 2.0) + 6.0);
+
+  // Each level convolves the level below it with the first copy, summing at most a stride of products.
+  double charLevel = charFirst;
+  for(int conLevel = 1; conLevel < 7; conLevel++)
+    charLevel += charFirst + 2.0 * (this->rules.character.GetStride() + 1.0);
+  double weapLevel = weapFirst;
+  for(int refLevel = 1; refLevel < 5; refLevel++)
+    weapLevel += weapFirst + 2.0 * (this->rules.weapon.GetStride() + 1.0);
+
+  // The longest pair cell is the worst of all.
+  return charLevel + weapLevel + 2.0 * (std::min(this->CharacterPulls(6), this->WeaponPulls(4)) + 1.0);
+}
+
+
+
+// ---- #
+// Exact tables.
+// Every rate of a banner is a fraction, so every value of its tables is too, and with the right denominators,
+// --- all of the calculations happen on integers, without the "gcd" a rational needs after each operation.
+// ---- #
+
+// An MPZ integer that can be kept in a "std::vector".
+struct GNSN_ExactInt
+{
+  mpz_t value;
+
+  GNSN_ExactInt() { mpz_init(value); }
+  GNSN_ExactInt(const GNSN_ExactInt& other) { mpz_init_set(value, other.value); }
+  GNSN_ExactInt& operator=(const GNSN_ExactInt& other) { mpz_set(value, other.value); return *this; }
+  ~GNSN_ExactInt() { mpz_clear(value); }
+};
+
+// Exact probabilities for the first pull counts: value "index" is "numerators[index] / (scale * base^(index + 1))".
+struct GNSN_ExactTable
+{
+  std::vector<GNSN_ExactInt> numerators;
+  GNSN_ExactInt scale;
+  GNSN_ExactInt base;
+
+  void GetQ(mpq_t target, int index) const
+  {
+    mpq_set_z(target, numerators[index].value);
+    mpz_pow_ui(mpq_denref(target), base.value, (unsigned long)index + 1);
+    mpz_mul(mpq_denref(target), mpq_denref(target), scale.value);
+    mpq_canonicalize(target);
+  }
+};
+
+// "long" is only 32 bits on some platforms, so the rates go in as two halves.
+static void GNSN_SetExact(mpz_t target, long long value)
+{
+  mpz_set_ui(target, (unsigned long)((unsigned long long)value >> 32));
+  mpz_mul_2exp(target, target, 32);
+  mpz_add_ui(target, target, (unsigned long)(value & 0xFFFFFFFFll));
+}
+
+// The distribution of any five-star, over the common denominator "D" of the base rate and the increment.
+static void GNSN_ExactSourceDist(const GNSN_PityRules& pity, int count, GNSN_ExactTable& dist)
+{
+  GNSN_ExactInt baseRate, increment, rate, remaining, number;
+  GNSN_SetExact(dist.base.value, pity.baseRate.denominator);
+  GNSN_SetExact(number.value, pity.softPityIncrement.denominator);
+  mpz_mul(dist.base.value, dist.base.value, number.value);
+  mpz_set_ui(dist.scale.value, 1);
+
+  GNSN_SetExact(baseRate.value, pity.baseRate.numerator);
+  mpz_mul(baseRate.value, baseRate.value, number.value);
+  GNSN_SetExact(increment.value, pity.softPityIncrement.numerator);
+  GNSN_SetExact(number.value, pity.baseRate.denominator);
+  mpz_mul(increment.value, increment.value, number.value);
+
+  // "remaining" is over "D^pullCount", the rate over "D", so their product is over "D^(pullCount + 1)".
+  dist.numerators.assign(count, GNSN_ExactInt());
+  mpz_set_ui(remaining.value, 1);
+  for(int pullCount = 0; pullCount < count && pullCount < pity.hardPity; pullCount++)
+  {
+    if(pullCount == pity.hardPity - 1)
+    {
+      mpz_set(rate.value, dist.base.value);
+    }
+    else if(pullCount > pity.softPity)
+    {
+      mpz_mul_ui(rate.value, increment.value, (unsigned long)(pullCount - pity.softPity));
+      mpz_add(rate.value, rate.value, baseRate.value);
+      if(mpz_cmp(rate.value, dist.base.value) > 0)
+        mpz_set(rate.value, dist.base.value);
+    }
+    else
+    {
+      mpz_set(rate.value, baseRate.value);
+    }
+    mpz_mul(dist.numerators[pullCount].value, rate.value, remaining.value);
+    mpz_sub(number.value, dist.base.value, rate.value);
+    mpz_mul(remaining.value, remaining.value, number.value);
+  }
+}
+
+// "target[i + j + 1] = a[i] * b[j]" summed, for the first "count" pull counts. Both tables have the same base.
+static void GNSN_ExactConvolve(GNSN_ExactTable& target, const GNSN_ExactTable& a, const GNSN_ExactTable& b, int count)
+{
+  target.numerators.assign(count, GNSN_ExactInt());
+  mpz_mul(target.scale.value, a.scale.value, b.scale.value);
+  mpz_set(target.base.value, a.base.value);
+  for(int indexA = 0; indexA < count && indexA < (int)a.numerators.size(); indexA++)
+  {
+    for(int indexB = 0; indexA + indexB + 1 < count && indexB < (int)b.numerators.size(); indexB++)
+    {
+      mpz_addmul(target.numerators[indexA + indexB + 1].value, a.numerators[indexA].value, b.numerators[indexB].value);
+    }
+  }
+}
+
+// "target += source * factor", where "target" has "factor" times the scale of "source".
+static void GNSN_ExactAddScaled(GNSN_ExactTable& target, const GNSN_ExactTable& source, const mpz_t factor)
+{
+  for(size_t index = 0; index < target.numerators.size() && index < source.numerators.size(); index++)
+  {
+    mpz_addmul(target.numerators[index].value, source.numerators[index].value, factor);
+  }
+}
+
+// The first copy of a character: the 50/50 won, or lost and then the guaranteed five-star. The scale is the 50/50's denominator.
+static void GNSN_ExactCharacterFirst(const GNSN_CharacterRules& rules, int count, GNSN_ExactTable& first)
+{
+  GNSN_ExactTable dist, lost;
+  GNSN_ExactSourceDist(rules.pity, count, dist);
+  GNSN_ExactConvolve(lost, dist, dist, count);
+
+  GNSN_ExactInt won, lose;
+  GNSN_SetExact(won.value, rules.featuredRate.numerator);
+  GNSN_SetExact(first.scale.value, rules.featuredRate.denominator);
+  mpz_sub(lose.value, first.scale.value, won.value);
+  mpz_set(first.base.value, dist.base.value);
+  first.numerators.assign(count, GNSN_ExactInt());
+  GNSN_ExactAddScaled(first, dist, won.value);
+  GNSN_ExactAddScaled(first, lost, lose.value);
+}
+
+// The first copy of a weapon, following the five-stars that aren't the specific one through the fate points,
+// --- the same way "CalcSSRWeaponFromState()" does from zero pity.
+// Every step multiplies by a fraction over "Q" (the featured denominator times the specific denominator),
+// --- so with the fate points at "F", the scale is "Q^(F + 1)".
+static void GNSN_ExactWeaponFirst(const GNSN_WeaponRules& rules, int count, GNSN_ExactTable& first)
+{
+  GNSN_ExactTable dist;
+  GNSN_ExactSourceDist(rules.pity, count, dist);
+
+  GNSN_ExactInt featured, featuredDen, specific, specificDen, q;
+  GNSN_SetExact(featured.value, rules.featuredRate.numerator);
+  GNSN_SetExact(featuredDen.value, rules.featuredRate.denominator);
+  GNSN_SetExact(specific.value, rules.specificRate.numerator);
+  GNSN_SetExact(specificDen.value, rules.specificRate.denominator);
+  mpz_mul(q.value, featuredDen.value, specificDen.value);
+
+  // Numerators over "Q" per [1 if guaranteed]: the specific five-star, the other featured one, a standard one.
+  GNSN_ExactInt toSpecific[2], toOther[2], toStandard[2];
+  mpz_mul(toSpecific[0].value, featured.value, specific.value);
+  mpz_mul(toSpecific[1].value, specific.value, featuredDen.value);
+  mpz_sub(toOther[1].value, specificDen.value, specific.value);
+  mpz_mul(toOther[0].value, featured.value, toOther[1].value);
+  mpz_mul(toOther[1].value, toOther[1].value, featuredDen.value);
+  mpz_sub(toStandard[0].value, featuredDen.value, featured.value);
+  mpz_mul(toStandard[0].value, toStandard[0].value, specificDen.value);
+  mpz_set_ui(toStandard[1].value, 0);
+
+  const int fatePoints = rules.fatePoints;
+  mpz_pow_ui(first.scale.value, q.value, (unsigned long)fatePoints + 1);
+  mpz_set(first.base.value, dist.base.value);
+  first.numerators.assign(count, GNSN_ExactInt());
+
+  // [fate points][1 if guaranteed], with the scale "Q^(fate points)".
+  std::vector<GNSN_ExactTable> pending((size_t)(fatePoints + 1) * 2);
+  for(int fate = 0; fate <= fatePoints; fate++)
+  {
+    for(int guaranteed = 0; guaranteed < 2; guaranteed++)
+    {
+      GNSN_ExactTable& table = pending[fate * 2 + guaranteed];
+      table.numerators.assign(count, GNSN_ExactInt());
+      mpz_pow_ui(table.scale.value, q.value, (unsigned long)fate);
+      mpz_set(table.base.value, dist.base.value);
+    }
+  }
+  pending[0] = dist;
+
+  GNSN_ExactInt factor;
+  GNSN_ExactTable next;
+  for(int fate = 0; fate <= fatePoints; fate++)
+  {
+    for(int guaranteed = 0; guaranteed < 2; guaranteed++)
+    {
+      const GNSN_ExactTable& table = pending[fate * 2 + guaranteed];
+
+      // With the fate points full, the five-star is the specific five-star.
+      if(fate == fatePoints)
+      {
+        GNSN_ExactAddScaled(first, table, q.value);
+        continue;
+      }
+
+      mpz_pow_ui(factor.value, q.value, (unsigned long)(fatePoints - fate));
+      mpz_mul(factor.value, factor.value, toSpecific[guaranteed].value);
+      GNSN_ExactAddScaled(first, table, factor.value);
+
+      GNSN_ExactConvolve(next, table, dist, count);
+      GNSN_ExactAddScaled(pending[(fate + 1) * 2], next, toOther[guaranteed].value);
+      GNSN_ExactAddScaled(pending[(fate + 1) * 2 + 1], next, toStandard[guaranteed].value);
+    }
+  }
+}
+
+// The first copy convolved with itself "level" times.
+static void GNSN_ExactLevel(const GNSN_ExactTable& first, int level, int count, GNSN_ExactTable& result)
+{
+  result = first;
+  GNSN_ExactTable previous;
+  for(int copy = 0; copy < level; copy++)
+  {
+    previous = result;
+    GNSN_ExactConvolve(result, previous, first, count);
+  }
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::CompareExact(const Value& value, mpq_t exact)
+{
+  mpq_t difference;
+  mpq_init(difference);
+  TScalar::GetQ(difference, value);
+  mpq_sub(difference, difference, exact);
+  mpq_abs(difference, difference);
+  const double result = mpq_get_d(difference);
+  mpq_clear(difference);
+  return result;
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::CheckSSRCharacterExact(int conLevel, int pulls)
+{
+  const Value* table = this->GetSSRCharacterTable(conLevel);
+  if(!table || pulls < 1 || pulls > this->CharacterPulls(conLevel))
+    return -1.0;
+
+  GNSN_ExactTable first, level;
+  GNSN_ExactCharacterFirst(this->rules.character, pulls, first);
+  GNSN_ExactLevel(first, conLevel, pulls, level);
+
+  mpq_t exact;
+  mpq_init(exact);
+  level.GetQ(exact, pulls - 1);
+  const double result = CompareExact(table[pulls - 1], exact);
+  mpq_clear(exact);
+  return result;
+}
+
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::CheckSSRWeaponExact(int refLevel, int pulls)
+{
+  const Value* table = this->GetSSRWeaponTable(refLevel);
+  if(!table || pulls < 1 || pulls > this->WeaponPulls(refLevel))
+    return -1.0;
+
+  GNSN_ExactTable first, level;
+  GNSN_ExactWeaponFirst(this->rules.weapon, pulls, first);
+  GNSN_ExactLevel(first, refLevel, pulls, level);
+
+  mpq_t exact;
+  mpq_init(exact);
+  level.GetQ(exact, pulls - 1);
+  const double result = CompareExact(table[pulls - 1], exact);
+  mpq_clear(exact);
+  return result;
+}
+
+// The two banners have different denominators, so the pair is summed as rationals, over the pull count splits.
+template<class TScalar>
+double GNSN_WProbCalcT<TScalar>::CheckSSRPairExact(int conLevel, int refLevel, int pulls)
+{
+  const Value* table = this->GetSSRPairTable(conLevel, refLevel);
+  if(!table || pulls < 1 || pulls > this->PairPulls(conLevel, refLevel))
+    return -1.0;
+
+  GNSN_ExactTable first, charLevel, weapLevel;
+  GNSN_ExactCharacterFirst(this->rules.character, pulls, first);
+  GNSN_ExactLevel(first, conLevel, pulls, charLevel);
+  GNSN_ExactWeaponFirst(this->rules.weapon, pulls, first);
+  GNSN_ExactLevel(first, refLevel, pulls, weapLevel);
+
+  mpq_t exact, charValue, weapValue;
+  mpq_init(exact);
+  mpq_init(charValue);
+  mpq_init(weapValue);
+  for(int charIndex = 0; charIndex + 1 < pulls; charIndex++)
+  {
+    const int weapIndex = pulls - 2 - charIndex;
+    if(mpz_sgn(charLevel.numerators[charIndex].value) == 0 || mpz_sgn(weapLevel.numerators[weapIndex].value) == 0)
+      continue;
+    charLevel.GetQ(charValue, charIndex);
+    weapLevel.GetQ(weapValue, weapIndex);
+    mpq_mul(charValue, charValue, weapValue);
+    mpq_add(exact, exact, charValue);
+  }
+  const double result = CompareExact(table[pulls - 1], exact);
+  mpq_clear(exact);
+  mpq_clear(charValue);
+  mpq_clear(weapValue);
+  return result;
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::SetPrecision(unsigned long); \
+  template void GNSN_WProbCalcT<TScalar>::SetOutputDigits(int); \
+  template void GNSN_WProbCalcT<TScalar>::SetAdaptivePrecision(int); \
+  template unsigned long GNSN_WProbCalcT<TScalar>::GetRequiredPrecision(int) const; \
+  template double GNSN_WProbCalcT<TScalar>::GetErrorBound() const; \
+  template double GNSN_WProbCalcT<TScalar>::ErrorGrowth() const; \
+  template double GNSN_WProbCalcT<TScalar>::CompareExact(const TScalar::Value&, mpq_t); \
+  template double GNSN_WProbCalcT<TScalar>::CheckSSRCharacterExact(int, int); \
+  template double GNSN_WProbCalcT<TScalar>::CheckSSRWeaponExact(int, int); \
+  template double GNSN_WProbCalcT<TScalar>::CheckSSRPairExact(int, int, int);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
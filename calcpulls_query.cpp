@@ -0,0 +1,618 @@
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+
+#include "calcpulls_query.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+// Query server, see "calcpulls_query.h".
+
+// The most a worker reads from one connection before handing it back, so one busy client can't keep a worker to itself.
+// It's one whole frame of the most queries, so a frame at the head of what was read is always read to its end.
+static const size_t kReadLimit = sizeof(GNSN_QueryFrame) + (size_t)GNSN_QueryFrame::kMaxCount * sizeof(GNSN_QueryRequest);
+
+
+
+// ---- #
+// Tables.
+// ---- #
+
+template<class TScalar>
+void GNSN_QueryTables::CopyTable(const typename TScalar::Value* probability, const typename TScalar::Value* cdf, int count, Table& table)
+{
+  table.probability.resize(count);
+  table.cdf.resize(count);
+  for(int pullCount = 0; pullCount < count; pullCount++)
+  {
+    table.probability[pullCount] = TScalar::GetD(probability[pullCount]);
+    table.cdf[pullCount] = TScalar::GetD(cdf[pullCount]);
+  }
+}
+
+template<class TScalar>
+void GNSN_QueryTables::Build(GNSN_WProbCalcT<TScalar>& calc)
+{
+  const GNSN_BannerRules& rules = calc.GetBannerRules();
+  const int charStride = rules.character.GetStride();
+  const int weapStride = rules.weapon.GetStride();
+
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+    CopyTable<TScalar>(calc.GetSSRCharacterTable(conLevel), calc.GetSSRCharacterCDFTable(conLevel), (conLevel + 1) * charStride, this->character[conLevel]);
+  for(int refLevel = 0; refLevel < 5; refLevel++)
+    CopyTable<TScalar>(calc.GetSSRWeaponTable(refLevel), calc.GetSSRWeaponCDFTable(refLevel), (refLevel + 1) * weapStride, this->weapon[refLevel]);
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    for(int refLevel = 0; refLevel < 5; refLevel++)
+    {
+      CopyTable<TScalar>(calc.GetSSRPairTable(conLevel, refLevel), calc.GetSSRPairCDFTable(conLevel, refLevel),
+        (conLevel + 1) * charStride + (refLevel + 1) * weapStride, this->pair[conLevel][refLevel]);
+    }
+  }
+  this->rulesText = calc.GetRulesText();
+}
+
+const GNSN_QueryTables::Table* GNSN_QueryTables::FindTable(int conLevel, int refLevel) const
+{
+  if(conLevel < -1 || conLevel >= 7 || refLevel < -1 || refLevel >= 5)
+    return nullptr;
+  if(refLevel < 0)
+    return (conLevel < 0) ? nullptr : &this->character[conLevel];
+  if(conLevel < 0)
+    return &this->weapon[refLevel];
+  return &this->pair[conLevel][refLevel];
+}
+
+void GNSN_QueryTables::Answer(const GNSN_QueryRequest& request, GNSN_QueryResponse& response) const
+{
+  response.id = request.id;
+  response.status = GNSN_QueryOK;
+  std::memset(response.reserved, 0, sizeof(response.reserved));
+  response.value = 0.0;
+
+  const Table* table = this->FindTable(request.conLevel, request.refLevel);
+  if(table == nullptr || table->cdf.empty())
+  {
+    response.status = GNSN_QueryBadLevel;
+    return;
+  }
+  const int count = (int)table->cdf.size();
+
+  if(request.kind == GNSN_QueryProbability || request.kind == GNSN_QueryCDF)
+  {
+    // Any whole number of pulls, including ones past the table, which has everything by its end.
+    if(!(request.argument >= -1e9 && request.argument <= 1e9) || request.argument != std::floor(request.argument))
+    {
+      response.status = GNSN_QueryBadArgument;
+      return;
+    }
+    const int pulls = (int)request.argument;
+    if(request.kind == GNSN_QueryProbability)
+      response.value = (pulls >= 1 && pulls <= count) ? table->probability[pulls - 1] : 0.0;
+    else if(pulls > 0)
+      response.value = table->cdf[std::min(pulls, count) - 1];
+  }
+  else if(request.kind == GNSN_QueryQuantile)
+  {
+    // The same search as "GNSN_WProbCalcT::SearchQuantile()", on the doubles.
+    const double probability = request.argument;
+    if(std::isnan(probability))
+      response.status = GNSN_QueryBadArgument;
+    else if(probability <= 0.0)
+      response.value = 0.0;
+    else if(table->cdf[count - 1] < probability)
+      response.value = -1.0;
+    else
+      response.value = (double)(std::lower_bound(table->cdf.begin(), table->cdf.end(), probability) - table->cdf.begin() + 1);
+  }
+  else
+  {
+    response.status = GNSN_QueryBadKind;
+  }
+}
+
+
+
+#ifndef _WIN32
+
+// ---- #
+// Sockets.
+// ---- #
+
+#ifdef MSG_NOSIGNAL
+static const int kSendFlags = MSG_NOSIGNAL; // A client gone away is an error here, not a signal.
+#else
+static const int kSendFlags = 0;
+#endif
+
+static bool SetNonBlocking(int socket)
+{
+  const int flags = fcntl(socket, F_GETFL, 0);
+  return flags >= 0 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+// Write as much of "data" as the socket has room for, and keep the rest.
+static bool WriteSome(int socket, std::vector<char>& data)
+{
+  size_t offset = 0;
+  while(offset < data.size())
+  {
+    const ssize_t written = send(socket, data.data() + offset, data.size() - offset, kSendFlags);
+    if(written > 0)
+      offset += (size_t)written;
+    else if(written < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;
+    else if(written < 0 && errno == EINTR)
+      continue;
+    else
+      return false;
+  }
+  data.erase(data.begin(), data.begin() + offset);
+  return true;
+}
+
+// Write all of "data" to a blocking socket.
+static bool WriteAll(int socket, const char* data, size_t size)
+{
+  while(size > 0)
+  {
+    const ssize_t written = send(socket, data, size, kSendFlags);
+    if(written > 0)
+    {
+      data += written;
+      size -= (size_t)written;
+    }
+    else if(written < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Read exactly "size" bytes from a blocking socket.
+static bool ReadAll(int socket, char* data, size_t size)
+{
+  while(size > 0)
+  {
+    const ssize_t received = recv(socket, data, size, 0);
+    if(received > 0)
+    {
+      data += received;
+      size -= (size_t)received;
+    }
+    else if(received < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    else
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+static bool MakeAddress(const char* path, sockaddr_un& address, std::string* error)
+{
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if(std::strlen(path) >= sizeof(address.sun_path))
+  {
+    if(error)
+      *error = std::string("socket path too long: \"") + path + "\"";
+    return false;
+  }
+  std::strcpy(address.sun_path, path);
+  return true;
+}
+
+
+
+// ---- #
+// Server.
+// ---- #
+
+bool GNSN_QueryServer::Start(const char* path, int workerCount, std::string* error)
+{
+  if(this->IsRunning())
+  {
+    if(error)
+      *error = "already running";
+    return false;
+  }
+
+  sockaddr_un address;
+  if(!MakeAddress(path, address, error))
+    return false;
+
+  // A socket file left by a server that didn't stop cleanly would make "bind()" fail, but anything else at the path stays.
+  struct stat existing;
+  if(stat(path, &existing) == 0)
+  {
+    if(!S_ISSOCK(existing.st_mode))
+    {
+      if(error)
+        *error = std::string("\"") + path + "\" exists and isn't a socket";
+      return false;
+    }
+    unlink(path);
+  }
+
+  const int listening = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(listening < 0
+    || bind(listening, (const sockaddr*)&address, sizeof(address)) != 0
+    || listen(listening, SOMAXCONN) != 0
+    || !SetNonBlocking(listening))
+  {
+    if(error)
+      *error = std::string("can't listen on \"") + path + "\": " + std::strerror(errno);
+    if(listening >= 0)
+      close(listening);
+    return false;
+  }
+  if(pipe(this->wakePipe) != 0)
+  {
+    if(error)
+      *error = std::string("can't make a pipe: ") + std::strerror(errno);
+    close(listening);
+    unlink(path);
+    return false;
+  }
+  SetNonBlocking(this->wakePipe[0]);
+  SetNonBlocking(this->wakePipe[1]);
+
+  this->listenSocket = listening;
+  this->socketPath = path;
+  this->stopping = false;
+
+  if(workerCount <= 0)
+    workerCount = GNSN_ThreadPool::HardwareThreads();
+  for(int worker = 0; worker < workerCount; worker++)
+    this->workers.emplace_back(&GNSN_QueryServer::WorkerMain, this);
+  this->pollThread = std::thread(&GNSN_QueryServer::PollMain, this);
+  return true;
+}
+
+void GNSN_QueryServer::Stop()
+{
+  if(!this->IsRunning())
+    return;
+
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->wake.notify_all();
+  const char byte = 0;
+  if(write(this->wakePipe[1], &byte, 1) < 0)
+  {
+    // The pipe is full, so the poll thread wakes up anyway.
+  }
+  for(std::thread& worker : this->workers)
+    worker.join();
+  this->workers.clear();
+  this->pollThread.join();
+
+  // The poll thread closed the idle connections, and these are the ones it never got back.
+  for(Connection* connection : this->ready)
+  {
+    close(connection->socket);
+    delete connection;
+  }
+  this->ready.clear();
+  for(Connection* connection : this->returned)
+  {
+    close(connection->socket);
+    delete connection;
+  }
+  this->returned.clear();
+
+  close(this->listenSocket);
+  close(this->wakePipe[0]);
+  close(this->wakePipe[1]);
+  unlink(this->socketPath.c_str());
+  this->listenSocket = -1;
+  this->wakePipe[0] = -1;
+  this->wakePipe[1] = -1;
+}
+
+void GNSN_QueryServer::HandBack(Connection* connection)
+{
+  {
+    std::lock_guard<std::mutex> lock(this->returnedMutex);
+    this->returned.push_back(connection);
+  }
+  const char byte = 0;
+  if(write(this->wakePipe[1], &byte, 1) < 0)
+  {
+    // The pipe is full, so the poll thread wakes up anyway.
+  }
+}
+
+void GNSN_QueryServer::PollMain()
+{
+  std::vector<Connection*> idle;
+  std::vector<pollfd> waits;
+  for(;;)
+  {
+    // The socket, the pipe the workers wake this thread with, and every connection no worker has,
+    // --- for room to send its answers if it has some left, or else for its next queries.
+    waits.clear();
+    waits.push_back({ this->listenSocket, POLLIN, 0 });
+    waits.push_back({ this->wakePipe[0], POLLIN, 0 });
+    for(Connection* connection : idle)
+      waits.push_back({ connection->socket, (short)(connection->outgoing.empty() ? POLLIN : POLLOUT), 0 });
+
+    if(poll(waits.data(), (nfds_t)waits.size(), -1) < 0 && errno != EINTR)
+      break;
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if(this->stopping)
+        break;
+    }
+
+    if(waits[1].revents != 0)
+    {
+      char drain[64];
+      while(read(this->wakePipe[0], drain, sizeof(drain)) > 0)
+      {
+      }
+    }
+
+    // Connections with something to read or room to send (or that closed) go to the workers, in the order they came up.
+    std::vector<Connection*> woken;
+    size_t kept = 0;
+    for(size_t index = 0; index < idle.size(); index++)
+    {
+      if(waits[index + 2].revents != 0)
+        woken.push_back(idle[index]);
+      else
+        idle[kept++] = idle[index];
+    }
+    idle.resize(kept);
+
+    if(waits[0].revents & POLLIN)
+    {
+      for(;;)
+      {
+        const int accepted = accept(this->listenSocket, nullptr, nullptr);
+        if(accepted < 0)
+          break;
+        if(!SetNonBlocking(accepted))
+        {
+          close(accepted);
+          continue;
+        }
+        Connection* connection = new Connection();
+        connection->socket = accepted;
+        idle.push_back(connection);
+      }
+    }
+
+    {
+      std::lock_guard<std::mutex> lock(this->returnedMutex);
+      idle.insert(idle.end(), this->returned.begin(), this->returned.end());
+      this->returned.clear();
+    }
+
+    if(!woken.empty())
+    {
+      {
+        std::lock_guard<std::mutex> lock(this->mutex);
+        this->ready.insert(this->ready.end(), woken.begin(), woken.end());
+      }
+      if(woken.size() == 1)
+        this->wake.notify_one();
+      else
+        this->wake.notify_all();
+    }
+  }
+
+  for(Connection* connection : idle)
+  {
+    close(connection->socket);
+    delete connection;
+  }
+}
+
+void GNSN_QueryServer::WorkerMain()
+{
+  for(;;)
+  {
+    Connection* connection;
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->wake.wait(lock, [this]() { return this->stopping || !this->ready.empty(); });
+      if(this->stopping)
+        return;
+      connection = this->ready.front();
+      this->ready.pop_front();
+    }
+
+    if(this->Serve(*connection))
+    {
+      this->HandBack(connection);
+    }
+    else
+    {
+      close(connection->socket);
+      delete connection;
+    }
+  }
+}
+
+// Send the answers left from before, then read what the connection has, answer every whole frame,
+// --- and keep the rest for next time, along with the answers the socket has no room for.
+// Returns false when the connection should be closed.
+bool GNSN_QueryServer::Serve(Connection& connection)
+{
+  std::vector<char>& answers = connection.outgoing;
+  if(!WriteSome(connection.socket, answers))
+    return false;
+  if(!answers.empty())
+    return true;
+  if(connection.closed)
+    return false;
+
+  std::vector<char>& pending = connection.pending;
+  while(pending.size() < kReadLimit)
+  {
+    const size_t start = pending.size();
+    pending.resize(start + 65536);
+    const ssize_t received = recv(connection.socket, pending.data() + start, 65536, 0);
+    pending.resize(start + (received > 0 ? (size_t)received : 0));
+    if(received > 0)
+      continue;
+    if(received == 0)
+      connection.closed = true;
+    else if(errno == EINTR)
+      continue;
+    else if(errno != EAGAIN && errno != EWOULDBLOCK)
+      return false;
+    break;
+  }
+
+  size_t offset = 0;
+  uint64_t queries = 0;
+  uint64_t frames = 0;
+  while(pending.size() - offset >= sizeof(GNSN_QueryFrame))
+  {
+    GNSN_QueryFrame frame;
+    std::memcpy(&frame, pending.data() + offset, sizeof(frame));
+    if(frame.magic != GNSN_QueryFrame::kMagic || frame.count > GNSN_QueryFrame::kMaxCount)
+      return false;
+    const size_t frameBytes = sizeof(GNSN_QueryFrame) + (size_t)frame.count * sizeof(GNSN_QueryRequest);
+    if(pending.size() - offset < frameBytes)
+      break;
+
+    // The answer has the same layout as the frame, so it goes in place of a copy of it.
+    const size_t answerStart = answers.size();
+    answers.insert(answers.end(), pending.begin() + offset, pending.begin() + offset + frameBytes);
+    char* requestData = answers.data() + answerStart + sizeof(GNSN_QueryFrame);
+    for(uint32_t index = 0; index < frame.count; index++)
+    {
+      GNSN_QueryRequest request;
+      GNSN_QueryResponse response;
+      std::memcpy(&request, requestData + index * sizeof(request), sizeof(request));
+      this->tables.Answer(request, response);
+      std::memcpy(requestData + index * sizeof(response), &response, sizeof(response));
+    }
+    offset += frameBytes;
+    queries += frame.count;
+    frames++;
+  }
+  pending.erase(pending.begin(), pending.begin() + offset);
+
+  this->queryCount.fetch_add(queries, std::memory_order_relaxed);
+  this->frameCount.fetch_add(frames, std::memory_order_relaxed);
+  if(!WriteSome(connection.socket, answers))
+    return false;
+  return !connection.closed || !answers.empty();
+}
+
+
+
+// ---- #
+// Client.
+// ---- #
+
+bool GNSN_QueryClient::Connect(const char* path)
+{
+  this->Close();
+
+  sockaddr_un address;
+  if(!MakeAddress(path, address, nullptr))
+    return false;
+  const int connected = socket(AF_UNIX, SOCK_STREAM, 0);
+  if(connected < 0)
+    return false;
+  if(connect(connected, (const sockaddr*)&address, sizeof(address)) != 0)
+  {
+    close(connected);
+    return false;
+  }
+  this->connection = connected;
+  return true;
+}
+
+void GNSN_QueryClient::Close()
+{
+  if(this->connection >= 0)
+    close(this->connection);
+  this->connection = -1;
+}
+
+bool GNSN_QueryClient::Send(const GNSN_QueryRequest* requests, uint32_t count)
+{
+  if(this->connection < 0 || count > GNSN_QueryFrame::kMaxCount)
+    return false;
+
+  std::vector<char> data(sizeof(GNSN_QueryFrame) + (size_t)count * sizeof(GNSN_QueryRequest));
+  const GNSN_QueryFrame frame = { GNSN_QueryFrame::kMagic, count };
+  std::memcpy(data.data(), &frame, sizeof(frame));
+  if(count > 0)
+    std::memcpy(data.data() + sizeof(frame), requests, (size_t)count * sizeof(GNSN_QueryRequest));
+  return WriteAll(this->connection, data.data(), data.size());
+}
+
+bool GNSN_QueryClient::Receive(GNSN_QueryResponse* responses, uint32_t count)
+{
+  if(this->connection < 0)
+    return false;
+
+  GNSN_QueryFrame frame;
+  if(!ReadAll(this->connection, (char*)&frame, sizeof(frame))
+    || frame.magic != GNSN_QueryFrame::kMagic || frame.count != count)
+    return false;
+  return ReadAll(this->connection, (char*)responses, (size_t)count * sizeof(GNSN_QueryResponse));
+}
+
+bool GNSN_QueryClient::Query(const GNSN_QueryRequest* requests, GNSN_QueryResponse* responses, uint32_t count)
+{
+  return this->Send(requests, count) && this->Receive(responses, count);
+}
+
+#else
+
+// Unix domain sockets only, for now.
+
+bool GNSN_QueryServer::Start(const char*, int, std::string* error)
+{
+  if(error)
+    *error = "the query server needs Unix domain sockets";
+  return false;
+}
+
+void GNSN_QueryServer::Stop() {}
+void GNSN_QueryServer::PollMain() {}
+void GNSN_QueryServer::WorkerMain() {}
+bool GNSN_QueryServer::Serve(Connection&) { return false; }
+void GNSN_QueryServer::HandBack(Connection*) {}
+
+bool GNSN_QueryClient::Connect(const char*) { return false; }
+void GNSN_QueryClient::Close() {}
+bool GNSN_QueryClient::Send(const GNSN_QueryRequest*, uint32_t) { return false; }
+bool GNSN_QueryClient::Receive(GNSN_QueryResponse*, uint32_t) { return false; }
+bool GNSN_QueryClient::Query(const GNSN_QueryRequest*, GNSN_QueryResponse*, uint32_t) { return false; }
+
+#endif
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_QueryTables::Build<TScalar>(GNSN_WProbCalcT<TScalar>&); \
+  template void GNSN_QueryTables::CopyTable<TScalar>(const TScalar::Value*, const TScalar::Value*, int, Table&);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
@@ -0,0 +1,207 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "calcpulls.h"
+
+// ---- #
+// Query server.
+// The tables are calculated (or loaded) once, copied into "GNSN_QueryTables" as doubles, and then answered from
+// --- by a fixed pool of workers, for any number of clients on a Unix domain socket.
+//
+// Protocol, in the byte order of the machine (the socket is local):
+// --- a client sends frames, each a "GNSN_QueryFrame" and "count" "GNSN_QueryRequest"s,
+// --- and gets back one frame for each, a "GNSN_QueryFrame" and "count" "GNSN_QueryResponse"s in the same order.
+// Frames may be sent without waiting for the answers to the ones before (pipelining), and are answered in the order sent.
+// A frame with the wrong magic or more than "kMaxCount" queries closes the connection.
+// ---- #
+
+struct GNSN_QueryFrame
+{
+  static const uint32_t kMagic = 0x51534E47; // "GNSQ" in little endian.
+  static const uint32_t kMaxCount = 65536;
+
+  uint32_t magic;
+  uint32_t count; // Queries or responses following.
+};
+
+enum GNSN_QueryKind : uint8_t
+{
+  GNSN_QueryProbability = 1, // Probability to get the level on exactly "pulls" pulls.
+  GNSN_QueryCDF = 2,         // Probability to have the level within "pulls" pulls.
+  GNSN_QueryQuantile = 3,    // Fewest pulls to have the level with at least "probability", or -1 if the table never gets there.
+};
+
+enum GNSN_QueryStatus : uint8_t
+{
+  GNSN_QueryOK = 0,
+  GNSN_QueryBadKind = 1,
+  GNSN_QueryBadLevel = 2,
+  GNSN_QueryBadArgument = 3,
+};
+
+// A level of -1 leaves that banner out, so "conLevel" alone is a character query, "refLevel" alone a weapon query,
+// --- and both a pair query.
+struct GNSN_QueryRequest
+{
+  uint32_t id;     // Handed back in the response.
+  uint8_t kind;    // "GNSN_QueryKind".
+  int8_t conLevel; // 0 to 6, or -1.
+  int8_t refLevel; // 0 to 4, or -1.
+  uint8_t reserved;
+  double argument; // "pulls" for probability and CDF queries, "probability" for quantile queries.
+};
+
+struct GNSN_QueryResponse
+{
+  uint32_t id;
+  uint8_t status;  // "GNSN_QueryStatus".
+  uint8_t reserved[3];
+  double value;    // The probability, or the pulls of a quantile query.
+};
+
+static_assert(sizeof(GNSN_QueryFrame) == 8, "query frame layout");
+static_assert(sizeof(GNSN_QueryRequest) == 16, "query request layout");
+static_assert(sizeof(GNSN_QueryResponse) == 16, "query response layout");
+
+
+
+// ---- #
+// The tables of a calculator as doubles, for answering queries from any number of threads at once.
+// "Build()" calculates whatever the calculator doesn't have yet. After that, nothing here changes.
+// ---- #
+
+class GNSN_QueryTables
+{
+private:
+  struct Table
+  {
+    std::vector<double> probability; // Indexed by pull count - 1.
+    std::vector<double> cdf;
+  };
+
+  Table character[7];
+  Table weapon[5];
+  Table pair[7][5];
+  std::string rulesText;
+
+public:
+  template<class TScalar>
+  void Build(GNSN_WProbCalcT<TScalar>& calc);
+
+  void Answer(const GNSN_QueryRequest& request, GNSN_QueryResponse& response) const;
+
+  // The banner rules the tables were calculated with, see "GetRulesText()" of the calculator.
+  const std::string& GetRulesText() const { return rulesText; }
+
+private:
+  const Table* FindTable(int conLevel, int refLevel) const;
+
+  template<class TScalar>
+  static void CopyTable(const typename TScalar::Value* probability, const typename TScalar::Value* cdf, int count, Table& table);
+};
+
+
+
+// ---- #
+// The server: one thread waits on the socket and on every idle connection,
+// --- and hands a connection with data to the next free worker, which answers every whole frame it has read.
+// So a connection is served by one worker at a time, keeping its answers in order,
+// --- and a worker never waits on a slow client while others have queries:
+// --- answers the socket has no room for stay with the connection, and the poll thread waits for room to send them.
+// Nothing more is read from a connection until its answers are out, so a client that doesn't take them only holds up itself.
+// ---- #
+
+class GNSN_QueryServer
+{
+private:
+  struct Connection
+  {
+    int socket;
+    std::vector<char> pending;  // Bytes of a frame not read whole yet.
+    std::vector<char> outgoing; // Answers not sent yet.
+    bool closed = false;        // The client sent everything it will, and only waits for its answers.
+  };
+
+private:
+  const GNSN_QueryTables& tables;
+
+  int listenSocket = -1;
+  int wakePipe[2] = { -1, -1 };
+  std::string socketPath;
+
+  std::thread pollThread;
+  std::vector<std::thread> workers;
+
+  // Connections with data to read, waiting for a worker.
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::deque<Connection*> ready;
+  bool stopping = false;
+
+  // Connections the workers are done with for now, for the poll thread to wait on again.
+  std::mutex returnedMutex;
+  std::vector<Connection*> returned;
+
+  std::atomic<uint64_t> queryCount{ 0 };
+  std::atomic<uint64_t> frameCount{ 0 };
+
+public:
+  explicit GNSN_QueryServer(const GNSN_QueryTables& tables) : tables(tables) {}
+  ~GNSN_QueryServer() { Stop(); }
+
+  GNSN_QueryServer(const GNSN_QueryServer&) = delete;
+  GNSN_QueryServer& operator=(const GNSN_QueryServer&) = delete;
+
+  // Listen on a Unix domain socket at "path" (replacing a socket file left there), with "workerCount" workers,
+  // --- where 0 means one per hardware thread. On failure, "error" (if given) says why.
+  bool Start(const char* path, int workerCount, std::string* error = nullptr);
+
+  // Stop the threads, close every connection and remove the socket file.
+  void Stop();
+
+  bool IsRunning() const { return listenSocket >= 0; }
+  uint64_t GetQueryCount() const { return queryCount.load(std::memory_order_relaxed); }
+  uint64_t GetFrameCount() const { return frameCount.load(std::memory_order_relaxed); }
+
+private:
+  void PollMain();
+  void WorkerMain();
+  bool Serve(Connection& connection);
+  void HandBack(Connection* connection);
+};
+
+
+
+// ---- #
+// A client for the server; anything that speaks the protocol works the same.
+// "Send()" and "Receive()" are separate so frames can be pipelined: send several, then receive as many.
+// ---- #
+
+class GNSN_QueryClient
+{
+private:
+  int connection = -1;
+
+public:
+  GNSN_QueryClient() {}
+  ~GNSN_QueryClient() { Close(); }
+
+  GNSN_QueryClient(const GNSN_QueryClient&) = delete;
+  GNSN_QueryClient& operator=(const GNSN_QueryClient&) = delete;
+
+  bool Connect(const char* path);
+  void Close();
+
+  bool Send(const GNSN_QueryRequest* requests, uint32_t count);
+  bool Receive(GNSN_QueryResponse* responses, uint32_t count);
+
+  // "Send()" then "Receive()".
+  bool Query(const GNSN_QueryRequest* requests, GNSN_QueryResponse* responses, uint32_t count);
+};
\ No newline at end of file
@@ -0,0 +1,294 @@
+#include <cctype>
+#include <climits>
+#include <fstream>
+#include <sstream>
+
+#include "calcpulls_rules.h"
+
+// Banner rules, see "calcpulls_rules.h".
+
+// The most a hard pity may be, so that every table's pull counts fit in an "int".
+static const int kMaxHardPity = 10000;
+
+// The most fate points, which keeps a weapon copy within 17 hard pities.
+static const int kMaxFatePoints = 16;
+
+static std::string TrimText(const std::string& text)
+{
+  size_t first = 0;
+  size_t last = text.size();
+  while(first < last && std::isspace((unsigned char)text[first]))
+    first++;
+  while(last > first && std::isspace((unsigned char)text[last - 1]))
+    last--;
+  return text.substr(first, last - first);
+}
+
+// Whole numbers only, without a sign.
+static bool ParseCount(const std::string& text, long long& value)
+{
+  if(text.empty() || text.size() > 15)
+    return false;
+  value = 0;
+  for(char c : text)
+  {
+    if(c < '0' || c > '9')
+      return false;
+    value = value * 10 + (c - '0');
+  }
+  return true;
+}
+
+// "a/b", "a", or "a.b" (which becomes "ab / 10^digits").
+static bool ParseRate(const std::string& text, GNSN_Rate& rate)
+{
+  size_t slash = text.find('/');
+  if(slash != std::string::npos)
+  {
+    return ParseCount(TrimText(text.substr(0, slash)), rate.numerator)
+      && ParseCount(TrimText(text.substr(slash + 1)), rate.denominator);
+  }
+
+  size_t dot = text.find('.');
+  if(dot == std::string::npos)
+  {
+    rate.denominator = 1;
+    return ParseCount(text, rate.numerator);
+  }
+  const std::string fraction = text.substr(dot + 1);
+  if(!ParseCount(text.substr(0, dot) + fraction, rate.numerator))
+    return false;
+  rate.denominator = 1;
+  for(size_t digit = 0; digit < fraction.size(); digit++)
+    rate.denominator *= 10;
+  return true;
+}
+
+static bool ParseInt(const std::string& text, int& value)
+{
+  long long parsed;
+  if(!ParseCount(text, parsed) || parsed > INT_MAX)
+    return false;
+  value = (int)parsed;
+  return true;
+}
+
+static std::string RateText(const GNSN_Rate& rate)
+{
+  std::ostringstream text;
+  text << rate.numerator << "/" << rate.denominator;
+  return text.str();
+}
+
+bool GNSN_BannerRules::LoadFile(const char* path, std::string* error)
+{
+  std::ifstream ifs(path);
+  if(!ifs)
+  {
+    if(error)
+      *error = std::string("can't open \"") + path + "\"";
+    return false;
+  }
+  std::stringstream text;
+  text << ifs.rdbuf();
+  return this->Parse(text.str(), error);
+}
+
+bool GNSN_BannerRules::Parse(const std::string& text, std::string* error)
+{
+  GNSN_BannerRules rules = *this;
+  std::istringstream lines(text);
+  std::string line;
+  int lineNumber = 0;
+  while(std::getline(lines, line))
+  {
+    lineNumber++;
+    line = TrimText(line);
+    if(line.empty() || line[0] == '#')
+      continue;
+
+    // Every line sets one value, and anything else is an error.
+    std::string problem;
+    size_t equals = line.find('=');
+    if(equals == std::string::npos)
+    {
+      problem = "expected \"key = value\"";
+    }
+    else
+    {
+      const std::string key = TrimText(line.substr(0, equals));
+      const std::string value = TrimText(line.substr(equals + 1));
+      bool parsed = false;
+      if(key == "character.baseRate")
+        parsed = ParseRate(value, rules.character.pity.baseRate);
+      else if(key == "character.softPity")
+        parsed = ParseInt(value, rules.character.pity.softPity);
+      else if(key == "character.softPityIncrement")
+        parsed = ParseRate(value, rules.character.pity.softPityIncrement);
+      else if(key == "character.hardPity")
+        parsed = ParseInt(value, rules.character.pity.hardPity);
+      else if(key == "character.featuredRate")
+        parsed = ParseRate(value, rules.character.featuredRate);
+      else if(key == "weapon.baseRate")
+        parsed = ParseRate(value, rules.weapon.pity.baseRate);
+      else if(key == "weapon.softPity")
+        parsed = ParseInt(value, rules.weapon.pity.softPity);
+      else if(key == "weapon.softPityIncrement")
+        parsed = ParseRate(value, rules.weapon.pity.softPityIncrement);
+      else if(key == "weapon.hardPity")
+        parsed = ParseInt(value, rules.weapon.pity.hardPity);
+      else if(key == "weapon.featuredRate")
+        parsed = ParseRate(value, rules.weapon.featuredRate);
+      else if(key == "weapon.specificRate")
+        parsed = ParseRate(value, rules.weapon.specificRate);
+      else if(key == "weapon.fatePoints")
+        parsed = ParseInt(value, rules.weapon.fatePoints);
+      else
+        problem = "unknown key \"" + key + "\"";
+      if(!parsed && problem.empty())
+        problem = "bad value for \"" + key + "\"";
+    }
+
+    if(!problem.empty())
+    {
+      if(error)
+        *error = "line " + std::to_string(lineNumber) + ": " + problem;
+      return false;
+    }
+  }
+
+  std::string invalid;
+  if(!rules.Validate(&invalid))
+  {
+    if(error)
+      *error = invalid;
+    return false;
+  }
+  *this = rules;
+  return true;
+}
+
+// Compare "a / b" with "c / d" without multiplying them out, by their continued fractions.
+static int CompareFractions(unsigned long long a, unsigned long long b, unsigned long long c, unsigned long long d)
+{
+  for(;;)
+  {
+    const unsigned long long wholeA = a / b;
+    const unsigned long long wholeC = c / d;
+    if(wholeA != wholeC)
+      return wholeA < wholeC ? -1 : 1;
+    a %= b;
+    c %= d;
+    if(a == 0 || c == 0)
+      return (a == c) ? 0 : (a == 0 ? -1 : 1);
+
+    // Past the same whole part, "a / b" against "c / d" is "d / c" against "b / a".
+    const unsigned long long oldA = a;
+    const unsigned long long oldB = b;
+    a = d;
+    b = c;
+    c = oldB;
+    d = oldA;
+  }
+}
+
+int GNSN_PityRules::GetCertainPull() const
+{
+  if(this->baseRate.numerator >= this->baseRate.denominator)
+    return 0;
+
+  // The rate past soft pity is "(pullCount - softPity) * increment + base", which is 100% once the first part reaches "1 - base".
+  const unsigned long long missing = (unsigned long long)(this->baseRate.denominator - this->baseRate.numerator);
+  for(int pullCount = this->softPity + 1; pullCount < this->hardPity - 1; pullCount++)
+  {
+    const unsigned long long added = (unsigned long long)(pullCount - this->softPity) * (unsigned long long)this->softPityIncrement.numerator;
+    if(CompareFractions(added, (unsigned long long)this->softPityIncrement.denominator, missing, (unsigned long long)this->baseRate.denominator) >= 0)
+      return pullCount;
+  }
+  return this->hardPity - 1;
+}
+
+static bool ValidatePity(const GNSN_PityRules& pity, const char* banner, std::string* error)
+{
+  std::string problem;
+  if(pity.baseRate.numerator < 0 || pity.baseRate.denominator <= 0 || pity.baseRate.numerator > pity.baseRate.denominator)
+    problem = "baseRate must be between 0 and 1";
+  else if(pity.softPityIncrement.numerator < 0 || pity.softPityIncrement.denominator <= 0)
+    problem = "softPityIncrement must be at least 0";
+  else if(pity.hardPity < 1 || pity.hardPity > kMaxHardPity)
+    problem = "hardPity must be between 1 and " + std::to_string(kMaxHardPity);
+  else if(pity.softPity < 0 || pity.softPity >= pity.hardPity)
+    problem = "softPity must be at least 0 and below hardPity";
+  if(problem.empty())
+    return true;
+  if(error)
+    *error = std::string(banner) + "." + problem;
+  return false;
+}
+
+static bool ValidateRate(const GNSN_Rate& rate, const char* name, std::string* error)
+{
+  if(rate.numerator >= 0 && rate.denominator > 0 && rate.numerator <= rate.denominator)
+    return true;
+  if(error)
+    *error = std::string(name) + " must be between 0 and 1";
+  return false;
+}
+
+bool GNSN_BannerRules::Validate(std::string* error) const
+{
+  if(!ValidatePity(this->character.pity, "character", error)
+    || !ValidateRate(this->character.featuredRate, "character.featuredRate", error)
+    || !ValidatePity(this->weapon.pity, "weapon", error)
+    || !ValidateRate(this->weapon.featuredRate, "weapon.featuredRate", error)
+    || !ValidateRate(this->weapon.specificRate, "weapon.specificRate", error))
+    return false;
+
+  // Each fate point adds a hard pity to the stride of every weapon table.
+  if(this->weapon.fatePoints < 0 || this->weapon.fatePoints > kMaxFatePoints)
+  {
+    if(error)
+      *error = "weapon.fatePoints must be between 0 and " + std::to_string(kMaxFatePoints);
+    return false;
+  }
+  return true;
+}
+
+std::string GNSN_BannerRules::Describe() const
+{
+  std::ostringstream text;
+  text << "character: base " << RateText(this->character.pity.baseRate)
+    << ", soft pity after " << this->character.pity.softPity
+    << ", increment " << RateText(this->character.pity.softPityIncrement)
+    << ", hard pity " << this->character.pity.hardPity
+    << ", featured " << RateText(this->character.featuredRate) << "; ";
+  text << "weapon: base " << RateText(this->weapon.pity.baseRate)
+    << ", soft pity after " << this->weapon.pity.softPity
+    << ", increment " << RateText(this->weapon.pity.softPityIncrement)
+    << ", hard pity " << this->weapon.pity.hardPity
+    << ", featured " << RateText(this->weapon.featuredRate)
+    << ", specific " << RateText(this->weapon.specificRate)
+    << ", fate points " << this->weapon.fatePoints;
+  return text.str();
+}
+
+std::string GNSN_BannerRules::ToConfig() const
+{
+  std::ostringstream text;
+  text << "# Character event banner.\n";
+  text << "character.baseRate = " << RateText(this->character.pity.baseRate) << "\n";
+  text << "character.softPity = " << this->character.pity.softPity << "\n";
+  text << "character.softPityIncrement = " << RateText(this->character.pity.softPityIncrement) << "\n";
+  text << "character.hardPity = " << this->character.pity.hardPity << "\n";
+  text << "character.featuredRate = " << RateText(this->character.featuredRate) << "\n";
+  text << "\n";
+  text << "# Weapon event banner.\n";
+  text << "weapon.baseRate = " << RateText(this->weapon.pity.baseRate) << "\n";
+  text << "weapon.softPity = " << this->weapon.pity.softPity << "\n";
+  text << "weapon.softPityIncrement = " << RateText(this->weapon.pity.softPityIncrement) << "\n";
+  text << "weapon.hardPity = " << this->weapon.pity.hardPity << "\n";
+  text << "weapon.featuredRate = " << RateText(this->weapon.featuredRate) << "\n";
+  text << "weapon.specificRate = " << RateText(this->weapon.specificRate) << "\n";
+  text << "weapon.fatePoints = " << this->weapon.fatePoints << "\n";
+  return text.str();
+}
\ No newline at end of file
@@ -0,0 +1,163 @@
+#pragma once
+#include <string>
+
+// ---- #
+// Banner rules.
+// Everything the calculations take from the game: the rates, where soft pity starts and how fast it climbs, hard pity,
+// --- and how likely a five-star is to be a featured one. The tables are sized from these too,
+// --- since the most pulls a copy can take is hard pity times the five-stars it can take to get it.
+//
+// "GNSN_GenshinRules" is the stock set. A config file changes any of it, one "key = value" per line:
+// --- character.baseRate = 6/1000         weapon.baseRate = 7/1000
+// --- character.softPity = 72             weapon.softPity = 61
+// --- character.softPityIncrement = 60/1000  weapon.softPityIncrement = 70/1000
+// --- character.hardPity = 90             weapon.hardPity = 80
+// --- character.featuredRate = 1/2        weapon.featuredRate = 3/4
+// ---                                     weapon.specificRate = 1/2
+// ---                                     weapon.fatePoints = 2
+// Rates are fractions ("3/4"), whole numbers or decimals ("0.006"). Keys left out keep their stock value.
+// Empty lines and lines starting with '#' are skipped.
+// ---- #
+
+// A probability as a fraction, so every scalar policy gets it with one division.
+struct GNSN_Rate
+{
+  long long numerator;
+  long long denominator;
+
+  constexpr double ToDouble() const { return (double)numerator / (double)denominator; }
+  constexpr bool operator==(const GNSN_Rate& other) const { return numerator == other.numerator && denominator == other.denominator; }
+  constexpr bool operator!=(const GNSN_Rate& other) const { return !(*this == other); }
+};
+
+// The chance for any five-star on each pull.
+// Past "softPity" (as pull count - 1), each pull adds "softPityIncrement" to "baseRate", up to 100%,
+// --- and the pull at "hardPity" always has one.
+struct GNSN_PityRules
+{
+  GNSN_Rate baseRate;
+  int softPity;
+  GNSN_Rate softPityIncrement;
+  int hardPity;
+
+  // The first pull count (as pull count - 1) with a rate of 100%, worked out from the fractions:
+  // --- where soft pity reaches it, or else "hardPity - 1". No one has more pulls without a five-star than this.
+  int GetCertainPull() const;
+
+  constexpr bool operator==(const GNSN_PityRules& other) const
+  {
+    return baseRate == other.baseRate && softPity == other.softPity && softPityIncrement == other.softPityIncrement && hardPity == other.hardPity;
+  }
+  constexpr bool operator!=(const GNSN_PityRules& other) const { return !(*this == other); }
+};
+
+// The character event banner.
+// A five-star is the featured one with "featuredRate" (the 50/50), and losing that guarantees the next.
+struct GNSN_CharacterRules
+{
+  GNSN_PityRules pity;
+  GNSN_Rate featuredRate;
+
+  // The most pulls one copy can take: a lost 50/50 and the guaranteed five-star after it.
+  constexpr int GetStride() const { return 2 * pity.hardPity; }
+
+  constexpr bool operator==(const GNSN_CharacterRules& other) const { return pity == other.pity && featuredRate == other.featuredRate; }
+  constexpr bool operator!=(const GNSN_CharacterRules& other) const { return !(*this == other); }
+};
+
+// The weapon event banner.
+// A five-star is one of the featured ones with "featuredRate", and the specific one of those with "specificRate".
+// A standard five-star guarantees the next is featured, and "fatePoints" five-stars that aren't the specific one
+// --- make the next the specific one (the epitomized path).
+struct GNSN_WeaponRules
+{
+  GNSN_PityRules pity;
+  GNSN_Rate featuredRate;
+  GNSN_Rate specificRate;
+  int fatePoints;
+
+  // The most pulls one copy can take: every five-star before the fate points run out, and the one after.
+  constexpr int GetStride() const { return (fatePoints + 1) * pity.hardPity; }
+
+  constexpr bool operator==(const GNSN_WeaponRules& other) const
+  {
+    return pity == other.pity && featuredRate == other.featuredRate && specificRate == other.specificRate && fatePoints == other.fatePoints;
+  }
+  constexpr bool operator!=(const GNSN_WeaponRules& other) const { return !(*this == other); }
+};
+
+struct GNSN_BannerRules
+{
+  GNSN_CharacterRules character;
+  GNSN_WeaponRules weapon;
+
+  // Read rules from a config file, or from its text, on top of the rules already here.
+  // On failure, "error" (if given) says which line and why, and the rules are left as they were.
+  bool LoadFile(const char* path, std::string* error = nullptr);
+  bool Parse(const std::string& text, std::string* error = nullptr);
+
+  // Whether the calculator can use these rules, and if not, "error" (if given) says why.
+  bool Validate(std::string* error = nullptr) const;
+
+  // The rules on one line, to tell tables made with different rules apart (see "GetRulesText()" of the calculator).
+  std::string Describe() const;
+
+  // The rules as a config file that "Parse()" reads back.
+  std::string ToConfig() const;
+
+  bool operator==(const GNSN_BannerRules& other) const { return Describe() == other.Describe(); }
+  bool operator!=(const GNSN_BannerRules& other) const { return !(*this == other); }
+};
+
+// Genshin Impact's rules.
+constexpr GNSN_BannerRules GNSN_GenshinRules = {
+  { { { 6, 1000 }, 72, { 60, 1000 }, 90 }, { 1, 2 } },
+  { { { 7, 1000 }, 61, { 70, 1000 }, 80 }, { 3, 4 }, { 1, 2 }, 2 }
+};
+
+
+
+// ---- #
+// Source tables made at compile time.
+// The same steps the calculator takes for "ProbSrc..." and "ProbSrcDist...", in double,
+// --- so a calculator on doubles with the stock rules copies them instead of working them out.
+// ---- #
+
+template<int THardPity>
+struct GNSN_SourceTables
+{
+  double source[THardPity];
+  double sourceDist[THardPity];
+};
+
+template<int THardPity>
+constexpr GNSN_SourceTables<THardPity> GNSN_MakeSourceTables(const GNSN_PityRules& pity)
+{
+  GNSN_SourceTables<THardPity> tables = {};
+  const double baseRate = pity.baseRate.ToDouble();
+  const double increment = pity.softPityIncrement.ToDouble();
+  double remaining = 1.0;
+  for(int pullCount = 0; pullCount < THardPity; pullCount++)
+  {
+    double rate = baseRate;
+    if(pullCount == THardPity - 1)
+      rate = 1.0;
+    else if(pullCount > pity.softPity)
+      rate = (double)(pullCount - pity.softPity) * increment + baseRate;
+    if(rate > 1.0)
+      rate = 1.0;
+    tables.source[pullCount] = rate;
+    tables.sourceDist[pullCount] = rate * remaining;
+    remaining = remaining - tables.sourceDist[pullCount];
+  }
+  return tables;
+}
+
+constexpr GNSN_SourceTables<GNSN_GenshinRules.character.pity.hardPity> GNSN_GenshinCharacterSource =
+  GNSN_MakeSourceTables<GNSN_GenshinRules.character.pity.hardPity>(GNSN_GenshinRules.character.pity);
+constexpr GNSN_SourceTables<GNSN_GenshinRules.weapon.pity.hardPity> GNSN_GenshinWeaponSource =
+  GNSN_MakeSourceTables<GNSN_GenshinRules.weapon.pity.hardPity>(GNSN_GenshinRules.weapon.pity);
+
+// Every five-star happens by hard pity.
+static_assert(GNSN_GenshinCharacterSource.source[GNSN_GenshinRules.character.pity.hardPity - 1] == 1.0, "hard pity");
+static_assert(GNSN_GenshinWeaponSource.source[GNSN_GenshinRules.weapon.pity.hardPity - 1] == 1.0, "hard pity");
\ No newline at end of file
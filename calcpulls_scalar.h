@@ -0,0 +1,713 @@
+#pragma once
+#include <cmath>
+#include <cstdint>
+#include <charconv>
+#include <cstring>
+#include <string>
+#include <iostream>
+#include <limits>
+#include <vector>
+#include <mpir.h>
+#include "calcpulls_arena.h"
+#include "calcpulls_kernels.h"
+#include "calcpulls_stats.h"
+
+#if defined(__SIZEOF_FLOAT128__) && !defined(GNSN_WPROBCALC_NO_FLOAT128)
+#define GNSN_WPROBCALC_HAS_FLOAT128 1
+#include <cstdio>
+#include <quadmath.h>
+#endif
+
+// ---- #
+// Scalar policies.
+// A scalar policy tells GNSN_WProbCalcT which number type to store its probabilities in,
+// --- and how to do arithmetic with that type.
+// The functions are named after the MPF functions they stand in for (mpf_mul -> Mul, mpf_set_d -> SetD, ...),
+// --- with the result always being the first argument, so the calculations read the same for every policy.
+// Nothing here is global: a value gets its precision when it's initialized, from the calculator it belongs to,
+// --- so calculators with different precisions can run on different threads at once.
+// ---- #
+
+// Multiple precision floats from MPIR.
+// Slow, but this is the reference for every other policy.
+struct GNSN_ScalarMPF
+{
+  typedef mpf_t Value;
+
+  static const char* Name() { return "mpf"; }
+
+  // Bits of mantissa a value has at a requested precision. MPF gives at least as many as asked for.
+  static unsigned long MantissaBits(unsigned long precision) { return precision; }
+
+  static void Init(Value& target, unsigned long precision)
+  {
+    mpf_init2(target, precision);
+    GNSN_STATS_COUNT(allocCount, 1);
+    GNSN_STATS_COUNT(allocBytes, (target->_mp_prec + 1) * sizeof(mp_limb_t));
+  }
+  static void Clear(Value& target) { mpf_clear(target); }
+
+  // Initialize "count" values to 0 with "precision" bits, with all of their limbs next to each other in "arena".
+  // This is the layout "mpf_init2" gives a value (the precision in limbs plus one more), without a heap allocation per value.
+  // MPF never reallocates the limbs of a value with a set precision, so they stay in the arena.
+  // Don't "Clear()" these values; releasing the arena frees them.
+  static void InitArray(Value* values, int count, unsigned long precision, GNSN_Arena& arena)
+  {
+    const mp_size_t precLimbs = (mp_size_t)((precision + 2 * GMP_NUMB_BITS - 1) / GMP_NUMB_BITS);
+    mp_limb_t* limbs = arena.AllocateArray<mp_limb_t>((size_t)count * (precLimbs + 1));
+    GNSN_STATS_COUNT(allocCount, count);
+    GNSN_STATS_COUNT(allocBytes, (size_t)count * (precLimbs + 1) * sizeof(mp_limb_t));
+    for(int i = 0; i < count; i++)
+    {
+      values[i]->_mp_prec = (int)precLimbs;
+      values[i]->_mp_size = 0;
+      values[i]->_mp_exp = 0;
+      values[i]->_mp_d = limbs + (size_t)i * (precLimbs + 1);
+    }
+  }
+
+  static void Set(Value& target, const Value& source) { mpf_set(target, source); }
+  static void SetD(Value& target, double source) { mpf_set_d(target, source); }
+  // Rounded to the nearest double: "mpf_get_d()" truncates, so what it cut off is added back in double.
+  static double GetD(const Value& source)
+  {
+    const double truncated = mpf_get_d(source);
+    mpf_t rest;
+    mpf_init2(rest, mpf_get_prec(source));
+    mpf_set_d(rest, truncated);
+    mpf_sub(rest, source, rest);
+    const double result = truncated + mpf_get_d(rest);
+    mpf_clear(rest);
+    return result;
+  }
+  static int CmpD(const Value& a, double b) { return mpf_cmp_d(a, b); }
+
+  // The exact value, for checking against exact rationals.
+  static void GetQ(mpq_t target, const Value& source) { mpq_set_f(target, source); }
+
+  static void Add(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(add, 1); mpf_add(target, a, b); }
+  static void Sub(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(add, 1); mpf_sub(target, a, b); }
+  static void Mul(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(mul, 1); mpf_mul(target, a, b); }
+  static void Div(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(mul, 1); mpf_div(target, a, b); }
+
+  // Uses the stream's own formatting flags (std::fixed, std::setprecision, ...).
+  static void Write(std::ostream& os, const Value& source) { os << source; }
+
+  // ---- #
+  // Decimal output without a stream, used by "GNSN_Formatter" in "calcpulls_format.h".
+  // "Format()" writes "source" with "digits" digits after the point to "out" and returns the end of what it wrote,
+  // --- giving the same text as "Write()" to a stream set to "std::fixed" and "std::setprecision(digits)".
+  // "out" must have room for "FormatBytes(source, digits)" characters.
+  // ---- #
+
+  // The digit string from "mpf_get_str", kept between values.
+  class FormatScratch
+  {
+  public:
+    std::vector<char> digits;
+  };
+
+  static size_t FormatBytes(const Value& source, int digits)
+  {
+    const long exponent = source->_mp_exp > 0 ? source->_mp_exp : 0;
+    return (size_t)digits + 4 + (size_t)exponent * 20; // Sign, point, a carry into a new digit, and up to 20 digits per limb.
+  }
+
+  // The stream operator asks "mpf_get_str" for a few more digits than it prints, then rounds those half up.
+  // This asks for the same digits and rounds them the same way, so even values right between two outputs match.
+  static char* Format(FormatScratch& scratch, char* out, const Value& source, int digits)
+  {
+    const long limbDigits = (GMP_NUMB_BITS == 64) ? 19 : 9;
+    const long limbExp = source->_mp_exp;
+    long requested = digits + 3 + limbExp * (limbDigits + (limbExp >= 0 ? 1 : 0));
+    requested = (requested > 1) ? requested : 1;
+    if(scratch.digits.size() < (size_t)requested + 2)
+      scratch.digits.resize((size_t)requested + 2);
+
+    mp_exp_t exp;
+    char* text = mpf_get_str(scratch.digits.data(), &exp, 10, (size_t)requested, source);
+    if(*text == '-')
+    {
+      *out++ = '-';
+      text++;
+    }
+    long length = (long)std::strlen(text);
+
+    // The value is "0.<text> * 10^exp", of which the first "exp + digits" digits get printed.
+    long kept = (long)exp + digits;
+    if(kept >= 0 && kept < length && text[kept] >= '5')
+    {
+      long index = kept - 1;
+      while(index >= 0 && text[index] == '9')
+        text[index--] = '0';
+      if(index >= 0)
+      {
+        text[index]++;
+      }
+      else
+      {
+        // Carried past the first digit, as in 0.999... to 1.000...
+        std::memmove(text + 1, text, (size_t)kept);
+        text[0] = '1';
+        exp++;
+        kept++;
+      }
+    }
+    length = (kept < 0) ? 0 : (kept < length ? kept : length);
+
+    if(exp <= 0)
+      *out++ = '0';
+    for(long index = 0; index < exp; index++)
+      *out++ = (index < length) ? text[index] : '0';
+    *out++ = '.';
+    for(long index = exp; index < exp + digits; index++)
+      *out++ = (index >= 0 && index < length) ? text[index] : '0';
+    return out;
+  }
+
+  // A convolution kernel of the policy's own, which "GNSN_Convolution::Accumulate()" uses instead of its own ways when there is one.
+  // Returns false when there is none, as for MPF.
+  static bool AccumulateKernel(Value*, const Value*, int, const Value*, int, int) { return false; }
+
+  // ---- #
+  // Fixed point conversion, used by the split FFT convolution in "calcpulls_convolve.h".
+  // A fixed point number is an array of 64-bit words, least significant first, with "fracBits" bits below the binary point.
+  // ---- #
+
+  // Bits below the binary point to keep while convolving values of "precision" bits.
+  // 32 bits more than the precision, so the truncation stays below what the MPF values can hold.
+  static unsigned long ConvolutionBits(unsigned long precision) { return precision + 32; }
+
+  // Temporaries for the conversions, so they aren't allocated per value.
+  class FixedScratch
+  {
+  public:
+    mpf_t f;
+    mpz_t z;
+
+  public:
+    explicit FixedScratch(unsigned long bits)
+    {
+      mpf_init2(f, bits);
+      mpz_init2(z, bits);
+      GNSN_STATS_COUNT(allocCount, 2);
+      GNSN_STATS_COUNT(allocBytes, ((size_t)f->_mp_prec + 1 + (size_t)z->_mp_alloc) * sizeof(mp_limb_t));
+    }
+    ~FixedScratch() { mpf_clear(f); mpz_clear(z); }
+  };
+
+  // Store in "words", "source" rounded down to "fracBits" bits below the binary point.
+  // "source" must be non-negative and fit in "wordCount" words.
+  static void GetFixed(FixedScratch& scratch, const Value& source, unsigned long fracBits, uint64_t* words, int wordCount)
+  {
+    size_t written = 0;
+    mpf_mul_2exp(scratch.f, source, fracBits);
+    mpz_set_f(scratch.z, scratch.f);
+    mpz_export(words, &written, -1, sizeof(uint64_t), 0, 0, scratch.z);
+    for(int i = (int)written; i < wordCount; i++)
+      words[i] = 0;
+  }
+
+  // Add to "target", the fixed point number in "words".
+  static void AddFixed(FixedScratch& scratch, Value& target, const uint64_t* words, int wordCount, unsigned long fracBits)
+  {
+    mpz_import(scratch.z, wordCount, -1, sizeof(uint64_t), 0, 0, words);
+    mpf_set_z(scratch.f, scratch.z);
+    mpf_div_2exp(scratch.f, scratch.f, fracBits);
+    mpf_add(target, target, scratch.f);
+    GNSN_STATS_COUNT(add, 1);
+  }
+
+  // ---- #
+  // Binary storage, used by the table files of "calcpulls_binary.cpp".
+  // A stored array is "_mp_size" and "_mp_exp" for every value, then the limbs of every value one after another,
+  // --- each value taking the limbs "mpf_init2(precision)" would give it, so the limbs can be used right from a mapped file.
+  // ---- #
+
+  // The precision a table file records for values of "precision" bits.
+  static unsigned long StoredPrecision(unsigned long precision) { return precision; }
+
+  static size_t StoredLimbs(unsigned long precision) { return (size_t)((precision + 2 * GMP_NUMB_BITS - 1) / GMP_NUMB_BITS) + 1; }
+
+  static size_t StoredBytes(int count, unsigned long precision)
+  {
+    return (size_t)count * (2 * sizeof(int64_t) + StoredLimbs(precision) * sizeof(mp_limb_t));
+  }
+
+  static void Store(const Value* values, int count, unsigned long precision, char* out)
+  {
+    const size_t limbCount = StoredLimbs(precision);
+    int64_t* heads = reinterpret_cast<int64_t*>(out);
+    mp_limb_t* limbs = reinterpret_cast<mp_limb_t*>(out + (size_t)count * 2 * sizeof(int64_t));
+    for(int i = 0; i < count; i++)
+    {
+      // Keep the most significant limbs if a value has more than the stored precision.
+      int size = values[i]->_mp_size;
+      size_t used = (size_t)(size < 0 ? -size : size);
+      const size_t skipped = (used > limbCount) ? used - limbCount : 0;
+      used -= skipped;
+      heads[2 * i] = (size < 0) ? -(int64_t)used : (int64_t)used;
+      heads[2 * i + 1] = values[i]->_mp_exp;
+      mp_limb_t* target = limbs + (size_t)i * limbCount;
+      std::memset(target, 0, limbCount * sizeof(mp_limb_t));
+      if(used > 0)
+        std::memcpy(target, values[i]->_mp_d + skipped, used * sizeof(mp_limb_t));
+    }
+  }
+
+  // Values pointing at the limbs in "data", with the values themselves in "arena".
+  static Value* MapStored(char* data, int count, unsigned long precision, GNSN_Arena& arena)
+  {
+    const size_t limbCount = StoredLimbs(precision);
+    const int64_t* heads = reinterpret_cast<const int64_t*>(data);
+    mp_limb_t* limbs = reinterpret_cast<mp_limb_t*>(data + (size_t)count * 2 * sizeof(int64_t));
+    Value* values = arena.AllocateArray<Value>(count);
+    for(int i = 0; i < count; i++)
+    {
+      values[i]->_mp_prec = (int)(limbCount - 1);
+      values[i]->_mp_size = (int)heads[2 * i];
+      values[i]->_mp_exp = (mp_exp_t)heads[2 * i + 1];
+      values[i]->_mp_d = limbs + (size_t)i * limbCount;
+    }
+    return values;
+  }
+};
+
+// Fixed point numbers on MPIR's "mpn_" functions: "TFracLimbs" limbs below the binary point and one limb above it.
+// The probabilities are all in [0, 1], so they don't need the exponent, normalization and varying size of MPF values:
+// --- every value is the same few limbs, the arithmetic is the plain "mpn_" routines on those,
+// --- and a table is its values' limbs one after another, with nothing to allocate per value.
+// Every operation rounds toward zero at 2^(-64 * TFracLimbs), so the error is absolute rather than relative as with MPF,
+// --- and values far below that (the farthest tails) come out as 0. A subtraction that would come out below 0
+// --- (after rounding, as in "1 - x" for an "x" just above 1) comes out as 0 too.
+// The precision is set by the type, so the precision requests are ignored; convert to MPF only for output.
+template<int TFracLimbs>
+struct GNSN_ScalarFixed
+{
+  static_assert(GMP_NUMB_BITS == 64 && sizeof(mp_limb_t) == sizeof(uint64_t), "64-bit limbs");
+
+  static const int kLimbs = TFracLimbs + 1;
+  static const unsigned long kFracBits = (unsigned long)TFracLimbs * 64;
+
+  // Least significant limb first, as for "mpn_" functions. "limbs[TFracLimbs]" is the part above the binary point.
+  struct Value
+  {
+    mp_limb_t limbs[kLimbs];
+  };
+
+  static unsigned long MantissaBits(unsigned long) { return kFracBits; }
+
+  static void Init(Value& target, unsigned long) { std::memset(target.limbs, 0, sizeof(target.limbs)); }
+  static void Clear(Value&) {}
+
+  // The arena holds the limbs themselves, so there's nothing more to set up.
+  static void InitArray(Value* values, int count, unsigned long, GNSN_Arena&)
+  {
+    std::memset(values, 0, (size_t)count * sizeof(Value));
+  }
+
+  static void Set(Value& target, const Value& source) { target = source; }
+  static void SetD(Value& target, double source) { FromDouble(target, source); }
+
+  // The top two limbs that aren't zero are all a double can hold.
+  static double GetD(const Value& source)
+  {
+    int top = kLimbs - 1;
+    while(top > 0 && source.limbs[top] == 0)
+      top--;
+    double result = std::ldexp((double)source.limbs[top], 64 * (top - TFracLimbs));
+    if(top > 0)
+      result += std::ldexp((double)source.limbs[top - 1], 64 * (top - 1 - TFracLimbs));
+    return result;
+  }
+
+  // Exact, through "b" as a fixed point number, and a "b" with bits below the last limb is just above what it rounds down to.
+  static int CmpD(const Value& a, double b)
+  {
+    if(b < 0.0)
+      return 1;
+    if(b >= 18446744073709551616.0)
+      return -1;
+    Value fixed;
+    const bool exact = FromDouble(fixed, b);
+    const int result = mpn_cmp(a.limbs, fixed.limbs, kLimbs);
+    return (result == 0 && !exact) ? -1 : (result > 0) - (result < 0);
+  }
+
+  static void GetQ(mpq_t target, const Value& source)
+  {
+    mpz_t numerator;
+    mpz_init(numerator);
+    mpz_import(numerator, kLimbs, -1, sizeof(mp_limb_t), 0, 0, source.limbs);
+    mpq_set_z(target, numerator);
+    mpq_div_2exp(target, target, kFracBits);
+    mpz_clear(numerator);
+  }
+
+  static void Add(Value& target, const Value& a, const Value& b)
+  {
+    GNSN_STATS_COUNT(add, 1);
+    mpn_add_n(target.limbs, a.limbs, b.limbs, kLimbs);
+  }
+
+  static void Sub(Value& target, const Value& a, const Value& b)
+  {
+    GNSN_STATS_COUNT(add, 1);
+    if(mpn_sub_n(target.limbs, a.limbs, b.limbs, kLimbs) != 0)
+      std::memset(target.limbs, 0, sizeof(target.limbs));
+  }
+
+  // The product has twice the limbs below the binary point, and the lower half is dropped.
+  // Both factors below 1 (nearly always) need only the fraction limbs multiplied.
+  static void Mul(Value& target, const Value& a, const Value& b)
+  {
+    GNSN_STATS_COUNT(mul, 1);
+    mp_limb_t product[2 * kLimbs];
+    if(a.limbs[TFracLimbs] == 0 && b.limbs[TFracLimbs] == 0)
+    {
+      mpn_mul_n(product, a.limbs, b.limbs, TFracLimbs);
+      std::memcpy(target.limbs, product + TFracLimbs, TFracLimbs * sizeof(mp_limb_t));
+      target.limbs[TFracLimbs] = 0;
+    }
+    else
+    {
+      mpn_mul_n(product, a.limbs, b.limbs, kLimbs);
+      std::memcpy(target.limbs, product + TFracLimbs, kLimbs * sizeof(mp_limb_t));
+    }
+  }
+
+  // "a" shifted up by the fraction limbs, over "b". Dividing by 0 gives 0.
+  static void Div(Value& target, const Value& a, const Value& b)
+  {
+    GNSN_STATS_COUNT(mul, 1);
+    mp_size_t divisorLimbs = kLimbs;
+    while(divisorLimbs > 0 && b.limbs[divisorLimbs - 1] == 0)
+      divisorLimbs--;
+    if(divisorLimbs == 0)
+    {
+      std::memset(target.limbs, 0, sizeof(target.limbs));
+      return;
+    }
+
+    mp_limb_t numerator[TFracLimbs + kLimbs] = {};
+    std::memcpy(numerator + TFracLimbs, a.limbs, kLimbs * sizeof(mp_limb_t));
+    mp_limb_t quotient[TFracLimbs + kLimbs + 1];
+    mp_limb_t remainder[kLimbs];
+    mpn_tdiv_qr(quotient, remainder, 0, numerator, TFracLimbs + kLimbs, b.limbs, divisorLimbs);
+    std::memcpy(target.limbs, quotient, kLimbs * sizeof(mp_limb_t));
+  }
+
+  // Through MPF, for the stream's own formatting flags.
+  static void Write(std::ostream& os, const Value& source)
+  {
+    mpz_t numerator;
+    mpf_t value;
+    mpz_init(numerator);
+    mpf_init2(value, kFracBits + 64);
+    mpz_import(numerator, kLimbs, -1, sizeof(mp_limb_t), 0, 0, source.limbs);
+    mpf_set_z(value, numerator);
+    mpf_div_2exp(value, value, kFracBits);
+    os << value;
+    mpf_clear(value);
+    mpz_clear(numerator);
+  }
+
+  // See "GNSN_ScalarMPF" for decimal output.
+  // The digits come straight from the fraction limbs, 19 at a time by multiplying with 10^19, then round half up like MPF's.
+  class FormatScratch
+  {
+  public:
+    std::string digits;
+  };
+
+  static size_t FormatBytes(const Value&, int digits) { return (size_t)digits + 24; } // Up to 20 digits above the point, the point, and a carry.
+
+  static char* Format(FormatScratch& scratch, char* out, const Value& source, int digits)
+  {
+    mp_limb_t fraction[TFracLimbs];
+    std::memcpy(fraction, source.limbs, sizeof(fraction));
+    scratch.digits.clear();
+    char chunk[20];
+    while((int)scratch.digits.size() < digits + 1)
+    {
+      const mp_limb_t high = mpn_mul_1(fraction, fraction, TFracLimbs, 10000000000000000000ull);
+      const size_t length = (size_t)(std::to_chars(chunk, chunk + sizeof(chunk), (uint64_t)high).ptr - chunk);
+      scratch.digits.append(19 - length, '0');
+      scratch.digits.append(chunk, length);
+    }
+
+    uint64_t integer = source.limbs[TFracLimbs];
+    std::string& text = scratch.digits;
+    if(text[digits] >= '5')
+    {
+      int index = digits - 1;
+      while(index >= 0 && text[index] == '9')
+        text[index--] = '0';
+      if(index >= 0)
+        text[index]++;
+      else
+        integer++;
+    }
+    out = std::to_chars(out, out + 21, integer).ptr;
+    *out++ = '.';
+    std::memcpy(out, text.data(), (size_t)digits);
+    return out + digits;
+  }
+
+  // See "GNSN_ScalarMPF" for the convolution kernel and the fixed point conversions.
+  // The values already are fixed point numbers, so the conversions only shift limbs.
+  static bool AccumulateKernel(Value*, const Value*, int, const Value*, int, int) { return false; }
+
+  static unsigned long ConvolutionBits(unsigned long) { return kFracBits; }
+
+  class FixedScratch
+  {
+  public:
+    explicit FixedScratch(unsigned long) {}
+  };
+
+  static void GetFixed(FixedScratch&, const Value& source, unsigned long fracBits, uint64_t* words, int wordCount)
+  {
+    Shift(source.limbs, kLimbs, (long)fracBits - (long)kFracBits, words, wordCount);
+  }
+
+  static void AddFixed(FixedScratch&, Value& target, const uint64_t* words, int wordCount, unsigned long fracBits)
+  {
+    Value value;
+    Shift(words, wordCount, (long)kFracBits - (long)fracBits, value.limbs, kLimbs);
+    Add(target, target, value);
+  }
+
+  // Binary storage, the limbs as they are in memory.
+  // See "GNSN_ScalarMPF" for what these are for.
+  static unsigned long StoredPrecision(unsigned long) { return kFracBits; }
+  static size_t StoredBytes(int count, unsigned long) { return (size_t)count * sizeof(Value); }
+  static void Store(const Value* values, int count, unsigned long, char* out) { std::memcpy(out, values, (size_t)count * sizeof(Value)); }
+  static Value* MapStored(char* data, int, unsigned long, GNSN_Arena&) { return reinterpret_cast<Value*>(data); }
+
+private:
+  // Set "target" to "source" rounded down, and return whether nothing was lost. "source" must be in [0, 2^64).
+  static bool FromDouble(Value& target, double source)
+  {
+    std::memset(target.limbs, 0, sizeof(target.limbs));
+    if(!(source > 0.0))
+      return source == 0.0;
+    const double integer = std::floor(source);
+    target.limbs[TFracLimbs] = (mp_limb_t)integer;
+    double rest = source - integer;
+    for(int limb = TFracLimbs - 1; limb >= 0 && rest != 0.0; limb--)
+    {
+      rest = std::ldexp(rest, 64);
+      const double digit = std::floor(rest);
+      rest -= digit;
+      target.limbs[limb] = (mp_limb_t)digit;
+    }
+    return rest == 0.0;
+  }
+
+  // "target" (of "targetCount" limbs) set to "source" times 2^"shift", dropping what falls off either end.
+  static void Shift(const uint64_t* source, int sourceCount, long shift, uint64_t* target, int targetCount)
+  {
+    const long limbShift = (shift >= 0) ? shift / 64 : -((-shift + 63) / 64);
+    const int bitShift = (int)(shift - limbShift * 64);
+    for(int index = 0; index < targetCount; index++)
+    {
+      // Bits of "target[index]" come from "source[index - limbShift]" shifted up, and from the limb below it.
+      const long from = index - limbShift;
+      const uint64_t current = (from >= 0 && from < sourceCount) ? source[from] : 0;
+      const uint64_t below = (from - 1 >= 0 && from - 1 < sourceCount) ? source[from - 1] : 0;
+      target[index] = (bitShift == 0) ? current : (current << bitShift) | (below >> (64 - bitShift));
+    }
+  }
+};
+
+// 256 bits below the binary point, as many as the MPF default.
+struct GNSN_ScalarFixed256 : public GNSN_ScalarFixed<4>
+{
+  static const char* Name() { return "fixed256"; }
+};
+
+// Exact scaling by powers of two and rounding down, overloaded for each native type.
+inline double GNSN_LdExp(double x, int exponent) { return std::ldexp(x, exponent); }
+inline long double GNSN_LdExp(long double x, int exponent) { return std::ldexp(x, exponent); }
+inline double GNSN_Floor(double x) { return std::floor(x); }
+inline long double GNSN_Floor(long double x) { return std::floor(x); }
+#ifdef GNSN_WPROBCALC_HAS_FLOAT128
+inline __float128 GNSN_LdExp(__float128 x, int exponent) { return ldexpq(x, exponent); }
+inline __float128 GNSN_Floor(__float128 x) { return floorq(x); }
+#endif
+
+// Native floating point types.
+// Precision is whatever the type has, so the precision requests are ignored.
+template<class T>
+struct GNSN_ScalarNative
+{
+  typedef T Value;
+
+  static unsigned long MantissaBits(unsigned long) { return std::numeric_limits<T>::digits; }
+
+  static void Init(Value& target, unsigned long) { target = 0; }
+  static void Clear(Value&) {}
+
+  // The arena holds the values themselves, so there's nothing more to set up.
+  static void InitArray(Value* values, int count, unsigned long, GNSN_Arena&)
+  {
+    for(int i = 0; i < count; i++)
+      values[i] = 0;
+  }
+
+  static void Set(Value& target, const Value& source) { target = source; }
+  static void SetD(Value& target, double source) { target = source; }
+  static double GetD(const Value& source) { return (double)source; }
+  static int CmpD(const Value& a, double b) { return (a > b) - (a < b); }
+
+  // Taken apart into doubles, each exact, until nothing is left (or what is left is below the smallest double).
+  static void GetQ(mpq_t target, const Value& source)
+  {
+    mpq_t part;
+    mpq_init(part);
+    mpq_set_ui(target, 0, 1);
+    Value rest = source;
+    while(rest != 0)
+    {
+      const double chunk = (double)rest;
+      if(chunk == 0.0)
+        break;
+      mpq_set_d(part, chunk);
+      mpq_add(target, target, part);
+      rest -= (Value)chunk;
+    }
+    mpq_clear(part);
+  }
+
+  static void Add(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(add, 1); target = a + b; }
+  static void Sub(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(add, 1); target = a - b; }
+  static void Mul(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(mul, 1); target = a * b; }
+  static void Div(Value& target, const Value& a, const Value& b) { GNSN_STATS_COUNT(mul, 1); target = a / b; }
+
+  static void Write(std::ostream& os, const Value& source) { os << source; }
+
+  // See "GNSN_ScalarMPF" for decimal output.
+  // "std::to_chars" gives the same exactly rounded digits as the stream's "printf" conversion.
+  class FormatScratch
+  {
+  };
+
+  static size_t FormatBytes(const Value&, int digits) { return (size_t)std::numeric_limits<T>::max_exponent10 + digits + 4; }
+
+  static char* Format(FormatScratch&, char* out, const Value& source, int digits)
+  {
+    return std::to_chars(out, out + FormatBytes(source, digits), source, std::chars_format::fixed, digits).ptr;
+  }
+
+  // See "GNSN_ScalarMPF" for the convolution kernel and the fixed point conversions.
+  static bool AccumulateKernel(Value*, const Value*, int, const Value*, int, int) { return false; }
+
+  // 64 bits more than the mantissa, so values far below 1 (the tails of the tables) keep most of their digits.
+  static unsigned long ConvolutionBits(unsigned long) { return std::numeric_limits<T>::digits + 64; }
+
+  class FixedScratch
+  {
+  public:
+    explicit FixedScratch(unsigned long) {}
+  };
+
+  static void GetFixed(FixedScratch&, const Value& source, unsigned long fracBits, uint64_t* words, int wordCount)
+  {
+    for(int i = 0; i < wordCount; i++)
+      words[i] = 0;
+
+    // Peel off 32 bits at a time, starting from the most significant half of the top word.
+    const int halfCount = wordCount * 2;
+    Value rest = GNSN_LdExp(source, (int)fracBits - halfCount * 32);
+    for(int half = halfCount - 1; half >= 0 && rest != 0; half--)
+    {
+      rest = GNSN_LdExp(rest, 32);
+      Value digit = GNSN_Floor(rest);
+      rest = rest - digit;
+      words[half / 2] |= (uint64_t)digit << (32 * (half % 2));
+    }
+  }
+
+  static void AddFixed(FixedScratch&, Value& target, const uint64_t* words, int wordCount, unsigned long fracBits)
+  {
+    Value sum = 0;
+    for(int i = wordCount - 1; i >= 0; i--)
+    {
+      if(words[i] == 0)
+        continue;
+      sum += GNSN_LdExp((Value)(words[i] >> 32), 64 * i + 32 - (int)fracBits);
+      sum += GNSN_LdExp((Value)(words[i] & 0xFFFFFFFFu), 64 * i - (int)fracBits);
+    }
+    target += sum;
+    GNSN_STATS_COUNT(add, 1);
+  }
+
+  // Binary storage, the values as they are in memory.
+  // See "GNSN_ScalarMPF" for what these are for.
+  static unsigned long StoredPrecision(unsigned long) { return sizeof(T) * 8; }
+  static size_t StoredBytes(int count, unsigned long) { return (size_t)count * sizeof(T); }
+  static void Store(const Value* values, int count, unsigned long, char* out) { std::memcpy(out, values, (size_t)count * sizeof(T)); }
+  static Value* MapStored(char* data, int, unsigned long, GNSN_Arena&) { return reinterpret_cast<Value*>(data); }
+};
+
+struct GNSN_ScalarDouble : public GNSN_ScalarNative<double>
+{
+  static const char* Name() { return "double"; }
+
+  // The compensated SIMD kernels of "calcpulls_kernels.h", for every length.
+  static bool AccumulateKernel(Value* target, const Value* a, int countA, const Value* b, int countB, int offset)
+  {
+    GNSN_STATS_COUNT(mul, (uint64_t)countA * countB);
+    GNSN_STATS_COUNT(add, (uint64_t)countA * countB);
+    GNSN_DoubleKernels::Accumulate(target, a, countA, b, countB, offset);
+    return true;
+  }
+};
+
+struct GNSN_ScalarLongDouble : public GNSN_ScalarNative<long double>
+{
+  static const char* Name() { return "long double"; }
+};
+
+#ifdef GNSN_WPROBCALC_HAS_FLOAT128
+// Quadruple precision through GCC's "__float128" (needs to be linked with "libquadmath").
+struct GNSN_ScalarFloat128 : public GNSN_ScalarNative<__float128>
+{
+  static const char* Name() { return "float128"; }
+
+  static unsigned long MantissaBits(unsigned long) { return FLT128_MANT_DIG; }
+
+  // "std::numeric_limits" isn't specialized for "__float128" outside of GNU mode.
+  static unsigned long ConvolutionBits(unsigned long) { return FLT128_MANT_DIG + 64; }
+
+  // Streams don't know about "__float128", so format it with the stream's flags through "libquadmath".
+  static void Write(std::ostream& os, const Value& source)
+  {
+    char buffer[128];
+    const bool fixed = (os.flags() & std::ios_base::floatfield) == std::ios_base::fixed;
+    quadmath_snprintf(buffer, sizeof(buffer), fixed ? "%.*Qf" : "%.*Qg", (int)os.precision(), source);
+    os << buffer;
+  }
+
+  static size_t FormatBytes(const Value&, int digits) { return (size_t)FLT128_MAX_10_EXP + digits + 4; }
+
+  static char* Format(FormatScratch&, char* out, const Value& source, int digits)
+  {
+    return out + quadmath_snprintf(out, FormatBytes(source, digits), "%.*Qf", digits, source);
+  }
+};
+
+#define GNSN_WPROBCALC_FOR_EACH_FLOAT128(X) X(GNSN_ScalarFloat128)
+#else
+#define GNSN_WPROBCALC_FOR_EACH_FLOAT128(X)
+#endif
+
+// Calls "X" with every available scalar policy.
+// Used to explicitly instantiate the calculator in each of its source files.
+#define GNSN_WPROBCALC_FOR_EACH_SCALAR(X) \
+  X(GNSN_ScalarMPF)                       \
+  X(GNSN_ScalarFixed256)                  \
+  X(GNSN_ScalarDouble)                    \
+  X(GNSN_ScalarLongDouble)                \
+  GNSN_WPROBCALC_FOR_EACH_FLOAT128(X)
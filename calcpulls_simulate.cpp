@@ -0,0 +1,450 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <mutex>
+#include <sstream>
+
+#include "calcpulls_simulate.h"
+
+// Monte Carlo simulation, see "calcpulls_simulate.h".
+
+// Trials side by side in one thread.
+static const int kLanes = 16;
+
+// Trials per task on the thread pool.
+static const int kBlockTrials = 16384;
+
+// Which banner a random number is for, as the last word of the counter.
+static const uint32_t kStreamCharacter = 0;
+static const uint32_t kStreamWeapon = 1;
+
+
+
+// ---- #
+// Philox-4x32-10 (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3").
+// ---- #
+
+static inline void PhiloxRound(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1)
+{
+  const uint64_t product0 = (uint64_t)0xD2511F53u * c0;
+  const uint64_t product1 = (uint64_t)0xCD9E8D57u * c2;
+  const uint32_t next0 = (uint32_t)(product1 >> 32) ^ c1 ^ k0;
+  const uint32_t next2 = (uint32_t)(product0 >> 32) ^ c3 ^ k1;
+  c1 = (uint32_t)product1;
+  c3 = (uint32_t)product0;
+  c0 = next0;
+  c2 = next2;
+}
+
+static inline void Philox(uint32_t& c0, uint32_t& c1, uint32_t& c2, uint32_t& c3, uint32_t k0, uint32_t k1)
+{
+  for(int round = 0; round < 10; round++)
+  {
+    PhiloxRound(c0, c1, c2, c3, k0, k1);
+    k0 += 0x9E3779B9u;
+    k1 += 0xBB67AE85u;
+  }
+}
+
+void GNSN_Philox::Generate(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4])
+{
+  result[0] = counter[0];
+  result[1] = counter[1];
+  result[2] = counter[2];
+  result[3] = counter[3];
+  Philox(result[0], result[1], result[2], result[3], key[0], key[1]);
+}
+
+// The threshold under which 32 random bits happen with "probability", where 2^32 is always.
+static uint64_t Threshold(double probability)
+{
+  if(probability <= 0.0)
+    return 0;
+  if(probability >= 1.0)
+    return (uint64_t)1 << 32;
+  return (uint64_t)std::llround(std::ldexp(probability, 32));
+}
+
+static void MakeThresholds(const GNSN_PityRules& pity, std::vector<uint64_t>& thresholds)
+{
+  // The same rates as "ProbSrc_SSR...".
+  thresholds.resize(pity.hardPity);
+  for(int pullCount = 0; pullCount < pity.hardPity; pullCount++)
+  {
+    double rate = pity.baseRate.ToDouble();
+    if(pullCount == pity.hardPity - 1)
+      rate = 1.0;
+    else if(pullCount > pity.softPity)
+      rate = (double)(pullCount - pity.softPity) * pity.softPityIncrement.ToDouble() + rate;
+    thresholds[pullCount] = Threshold(rate);
+  }
+}
+
+
+
+// ---- #
+// Counts.
+// ---- #
+
+void GNSN_Simulator::Counts::Reset(const GNSN_BannerRules& rules)
+{
+  const int charStride = rules.character.GetStride();
+  const int weapStride = rules.weapon.GetStride();
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+    this->character[conLevel].assign((size_t)(conLevel + 1) * charStride, 0);
+  for(int refLevel = 0; refLevel < 5; refLevel++)
+    this->weapon[refLevel].assign((size_t)(refLevel + 1) * weapStride, 0);
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    for(int refLevel = 0; refLevel < 5; refLevel++)
+      this->pair[conLevel][refLevel].assign((size_t)(conLevel + 1) * charStride + (size_t)(refLevel + 1) * weapStride, 0);
+  }
+  this->pulls = 0;
+}
+
+void GNSN_Simulator::Counts::Add(const Counts& other)
+{
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    for(size_t index = 0; index < this->character[conLevel].size(); index++)
+      this->character[conLevel][index] += other.character[conLevel][index];
+  }
+  for(int refLevel = 0; refLevel < 5; refLevel++)
+  {
+    for(size_t index = 0; index < this->weapon[refLevel].size(); index++)
+      this->weapon[refLevel][index] += other.weapon[refLevel][index];
+  }
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    for(int refLevel = 0; refLevel < 5; refLevel++)
+    {
+      std::vector<uint64_t>& target = this->pair[conLevel][refLevel];
+      const std::vector<uint64_t>& source = other.pair[conLevel][refLevel];
+      for(size_t index = 0; index < target.size(); index++)
+        target[index] += source[index];
+    }
+  }
+  this->pulls += other.pulls;
+}
+
+
+
+// ---- #
+// Simulator.
+// ---- #
+
+GNSN_Simulator::GNSN_Simulator(const GNSN_BannerRules& rules)
+  : rules(rules)
+{
+  MakeThresholds(rules.character.pity, this->charThreshold);
+  MakeThresholds(rules.weapon.pity, this->weapThreshold);
+  this->charFeatured = Threshold(rules.character.featuredRate.ToDouble());
+  this->weapFeatured = Threshold(rules.weapon.featuredRate.ToDouble());
+  this->weapSpecific = Threshold(rules.weapon.specificRate.ToDouble());
+  this->Reset();
+}
+
+void GNSN_Simulator::Reset()
+{
+  this->counts.Reset(this->rules);
+  this->trials = 0;
+  this->seconds = 0.0;
+}
+
+// Each lane runs a trial until it has seven copies, then takes the next trial of the block.
+// A lane past the last trial keeps pulling with the others, and what it gets is thrown away.
+void GNSN_Simulator::SimulateCharacter(uint64_t firstTrial, int trialCount, const uint32_t key[2], uint32_t* results) const
+{
+  const uint64_t* threshold = this->charThreshold.data();
+  const uint64_t featuredThreshold = this->charFeatured;
+
+  uint64_t trial[kLanes];
+  int slot[kLanes];
+  uint32_t pull[kLanes], pity[kLanes], guaranteed[kLanes], copies[kLanes], got[kLanes];
+  int nextTrial = 0;
+  int running = 0;
+  for(int lane = 0; lane < kLanes; lane++)
+  {
+    slot[lane] = (nextTrial < trialCount) ? nextTrial++ : -1;
+    running += (slot[lane] >= 0) ? 1 : 0;
+    trial[lane] = firstTrial + (uint64_t)std::max(slot[lane], 0);
+    pull[lane] = pity[lane] = guaranteed[lane] = copies[lane] = 0;
+  }
+
+  while(running > 0)
+  {
+    // One pull of every lane.
+    for(int lane = 0; lane < kLanes; lane++)
+    {
+      uint32_t c0 = (uint32_t)trial[lane], c1 = (uint32_t)(trial[lane] >> 32), c2 = pull[lane], c3 = kStreamCharacter;
+      Philox(c0, c1, c2, c3, key[0], key[1]);
+      const uint32_t five = (c0 < threshold[pity[lane]]) ? 1 : 0;
+      const uint32_t featured = guaranteed[lane] | ((c1 < featuredThreshold) ? 1 : 0);
+      const uint32_t copy = five & featured;
+      guaranteed[lane] = (guaranteed[lane] & (five ^ 1)) | (five & (featured ^ 1));
+      pity[lane] = (pity[lane] + 1) & (five - 1);
+      copies[lane] += copy;
+      pull[lane]++;
+      got[lane] = copy;
+    }
+
+    for(int lane = 0; lane < kLanes; lane++)
+    {
+      if(got[lane] == 0 || slot[lane] < 0)
+        continue;
+      results[(size_t)slot[lane] * 7 + copies[lane] - 1] = pull[lane];
+      if(copies[lane] < 7)
+        continue;
+      slot[lane] = (nextTrial < trialCount) ? nextTrial++ : -1;
+      running -= (slot[lane] < 0) ? 1 : 0;
+      trial[lane] = firstTrial + (uint64_t)std::max(slot[lane], 0);
+      pull[lane] = pity[lane] = guaranteed[lane] = copies[lane] = 0;
+    }
+  }
+}
+
+// The same for weapons, to five copies.
+// A five-star with the fate points full is the specific one. Otherwise it is featured with "featuredRate" (or always when guaranteed),
+// --- and a featured one is the specific one with "specificRate". Anything but the specific one adds a fate point,
+// --- and a standard one guarantees the next is featured.
+void GNSN_Simulator::SimulateWeapon(uint64_t firstTrial, int trialCount, const uint32_t key[2], uint32_t* results) const
+{
+  const uint64_t* threshold = this->weapThreshold.data();
+  const uint64_t featuredThreshold = this->weapFeatured;
+  const uint64_t specificThreshold = this->weapSpecific;
+  const uint32_t fateFull = (uint32_t)this->rules.weapon.fatePoints;
+
+  uint64_t trial[kLanes];
+  int slot[kLanes];
+  uint32_t pull[kLanes], pity[kLanes], guaranteed[kLanes], fate[kLanes], copies[kLanes], got[kLanes];
+  int nextTrial = 0;
+  int running = 0;
+  for(int lane = 0; lane < kLanes; lane++)
+  {
+    slot[lane] = (nextTrial < trialCount) ? nextTrial++ : -1;
+    running += (slot[lane] >= 0) ? 1 : 0;
+    trial[lane] = firstTrial + (uint64_t)std::max(slot[lane], 0);
+    pull[lane] = pity[lane] = guaranteed[lane] = fate[lane] = copies[lane] = 0;
+  }
+
+  while(running > 0)
+  {
+    for(int lane = 0; lane < kLanes; lane++)
+    {
+      uint32_t c0 = (uint32_t)trial[lane], c1 = (uint32_t)(trial[lane] >> 32), c2 = pull[lane], c3 = kStreamWeapon;
+      Philox(c0, c1, c2, c3, key[0], key[1]);
+      const uint32_t five = (c0 < threshold[pity[lane]]) ? 1 : 0;
+      const uint32_t featured = guaranteed[lane] | ((c1 < featuredThreshold) ? 1 : 0);
+      const uint32_t specific = ((fate[lane] >= fateFull) ? 1 : 0) | (featured & ((c2 < specificThreshold) ? 1 : 0));
+      const uint32_t copy = five & specific;
+      const uint32_t missed = five & (specific ^ 1);
+      guaranteed[lane] = (guaranteed[lane] & (five ^ 1)) | (missed & (featured ^ 1));
+      fate[lane] = (fate[lane] + missed) & (copy - 1);
+      pity[lane] = (pity[lane] + 1) & (five - 1);
+      copies[lane] += copy;
+      pull[lane]++;
+      got[lane] = copy;
+    }
+
+    for(int lane = 0; lane < kLanes; lane++)
+    {
+      if(got[lane] == 0 || slot[lane] < 0)
+        continue;
+      results[(size_t)slot[lane] * 5 + copies[lane] - 1] = pull[lane];
+      if(copies[lane] < 5)
+        continue;
+      slot[lane] = (nextTrial < trialCount) ? nextTrial++ : -1;
+      running -= (slot[lane] < 0) ? 1 : 0;
+      trial[lane] = firstTrial + (uint64_t)std::max(slot[lane], 0);
+      pull[lane] = pity[lane] = guaranteed[lane] = fate[lane] = copies[lane] = 0;
+    }
+  }
+}
+
+void GNSN_Simulator::Run(uint64_t trials, uint64_t seed, int threadCount)
+{
+  if(trials == 0)
+    return;
+  const std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  const uint32_t key[2] = { (uint32_t)seed, (uint32_t)(seed >> 32) };
+  const uint64_t firstTrial = this->trials;
+  const int taskCount = (int)((trials + kBlockTrials - 1) / kBlockTrials);
+
+  // Each task counts its block on its own, then adds it to the total.
+  std::mutex mutex;
+  GNSN_ThreadPool pool(threadCount);
+  pool.Run(taskCount, [&](int task) {
+    const uint64_t blockStart = (uint64_t)task * kBlockTrials;
+    const int trialCount = (int)std::min<uint64_t>(kBlockTrials, trials - blockStart);
+    std::vector<uint32_t> charPulls((size_t)trialCount * 7);
+    std::vector<uint32_t> weapPulls((size_t)trialCount * 5);
+    this->SimulateCharacter(firstTrial + blockStart, trialCount, key, charPulls.data());
+    this->SimulateWeapon(firstTrial + blockStart, trialCount, key, weapPulls.data());
+
+    Counts block;
+    block.Reset(this->rules);
+    for(int trial = 0; trial < trialCount; trial++)
+    {
+      const uint32_t* charTrial = &charPulls[(size_t)trial * 7];
+      const uint32_t* weapTrial = &weapPulls[(size_t)trial * 5];
+      for(int conLevel = 0; conLevel < 7; conLevel++)
+        block.character[conLevel][charTrial[conLevel] - 1]++;
+      for(int refLevel = 0; refLevel < 5; refLevel++)
+        block.weapon[refLevel][weapTrial[refLevel] - 1]++;
+
+      // The banners are pulled on separately, so a pair takes the pulls of both.
+      for(int conLevel = 0; conLevel < 7; conLevel++)
+      {
+        for(int refLevel = 0; refLevel < 5; refLevel++)
+          block.pair[conLevel][refLevel][charTrial[conLevel] + weapTrial[refLevel] - 1]++;
+      }
+      block.pulls += charTrial[6] + weapTrial[4];
+    }
+
+    std::lock_guard<std::mutex> lock(mutex);
+    this->counts.Add(block);
+  });
+
+  this->trials += trials;
+  this->seconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+
+
+// ---- #
+// Checks against the tables.
+// ---- #
+
+GNSN_SimulationCheck GNSN_Simulator::Check(const std::vector<uint64_t>& levelCounts, const std::vector<double>& table, double z) const
+{
+  GNSN_SimulationCheck check;
+  const double n = (double)this->trials;
+  if(this->trials == 0)
+    return check;
+
+  double sum = 0.0;
+  double sumSquares = 0.0;
+  for(size_t index = 0; index < levelCounts.size(); index++)
+  {
+    const double pulls = (double)(index + 1);
+    sum += pulls * (double)levelCounts[index];
+    sumSquares += pulls * pulls * (double)levelCounts[index];
+  }
+  check.mean = sum / n;
+  const double variance = std::max(0.0, sumSquares / n - check.mean * check.mean);
+  check.meanHalfWidth = z * std::sqrt(variance / n);
+  for(size_t index = 0; index < table.size(); index++)
+    check.meanExact += (double)(index + 1) * table[index];
+
+  uint64_t cumulative = 0;
+  double exact = 0.0;
+  for(size_t index = 0; index < levelCounts.size() && index < table.size(); index++)
+  {
+    cumulative += levelCounts[index];
+    exact += table[index];
+    const double distance = std::fabs((double)cumulative / n - exact);
+    if(distance > check.cdfDistance)
+    {
+      check.cdfDistance = distance;
+      check.cdfDistancePulls = (int)index + 1;
+
+      const double p = (double)cumulative / n;
+      check.cdfHalfWidth = z / (1.0 + z * z / n) * std::sqrt(p * (1.0 - p) / n + z * z / (4.0 * n * n));
+    }
+  }
+
+  // The two-sided tail of "z" standard deviations, as the chance the whole CDF may be off by more than the band.
+  const double alpha = std::erfc(z / std::sqrt(2.0));
+  check.cdfBand = std::sqrt(std::log(2.0 / alpha) / (2.0 * n));
+
+  check.passed = std::fabs(check.mean - check.meanExact) <= check.meanHalfWidth && check.cdfDistance <= check.cdfBand;
+  return check;
+}
+
+template<class TScalar>
+bool GNSN_Simulator::Compare(GNSN_WProbCalcT<TScalar>& calc, double z, GNSN_SimulationReport& report) const
+{
+  if(calc.GetBannerRules() != this->rules)
+    return false;
+
+  report = GNSN_SimulationReport();
+  report.trials = this->trials;
+  report.pulls = this->counts.pulls;
+  report.seconds = this->seconds;
+  report.z = z;
+
+  std::vector<double> table;
+  auto copyTable = [&table](const typename TScalar::Value* values, size_t count) {
+    table.resize(count);
+    for(size_t index = 0; index < count; index++)
+      table[index] = TScalar::GetD(values[index]);
+  };
+
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    copyTable(calc.GetSSRCharacterTable(conLevel), this->counts.character[conLevel].size());
+    report.checks.push_back(this->Check(this->counts.character[conLevel], table, z));
+    report.checks.back().conLevel = conLevel;
+  }
+  for(int refLevel = 0; refLevel < 5; refLevel++)
+  {
+    copyTable(calc.GetSSRWeaponTable(refLevel), this->counts.weapon[refLevel].size());
+    report.checks.push_back(this->Check(this->counts.weapon[refLevel], table, z));
+    report.checks.back().refLevel = refLevel;
+  }
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    for(int refLevel = 0; refLevel < 5; refLevel++)
+    {
+      copyTable(calc.GetSSRPairTable(conLevel, refLevel), this->counts.pair[conLevel][refLevel].size());
+      report.checks.push_back(this->Check(this->counts.pair[conLevel][refLevel], table, z));
+      report.checks.back().conLevel = conLevel;
+      report.checks.back().refLevel = refLevel;
+    }
+  }
+  return true;
+}
+
+bool GNSN_SimulationReport::Passed() const
+{
+  for(const GNSN_SimulationCheck& check : checks)
+  {
+    if(!check.passed)
+      return false;
+  }
+  return !checks.empty();
+}
+
+std::string GNSN_SimulationReport::ToJSON() const
+{
+  std::ostringstream os;
+  os.precision(10);
+  os << "{\n";
+  os << "  \"trials\": " << trials << ",\n";
+  os << "  \"pulls\": " << pulls << ",\n";
+  os << "  \"seconds\": " << seconds << ",\n";
+  os << "  \"pullsPerSecond\": " << (seconds > 0.0 ? (double)pulls / seconds : 0.0) << ",\n";
+  os << "  \"z\": " << z << ",\n";
+  os << "  \"passed\": " << (Passed() ? "true" : "false") << ",\n";
+  os << "  \"checks\": [";
+  for(size_t index = 0; index < checks.size(); index++)
+  {
+    const GNSN_SimulationCheck& check = checks[index];
+    os << (index == 0 ? "\n" : ",\n");
+    os << "    { \"conLevel\": " << check.conLevel << ", \"refLevel\": " << check.refLevel
+      << ", \"mean\": " << check.mean << ", \"meanHalfWidth\": " << check.meanHalfWidth << ", \"meanExact\": " << check.meanExact
+      << ", \"cdfDistance\": " << check.cdfDistance << ", \"cdfDistancePulls\": " << check.cdfDistancePulls
+      << ", \"cdfHalfWidth\": " << check.cdfHalfWidth << ", \"cdfBand\": " << check.cdfBand
+      << ", \"passed\": " << (check.passed ? "true" : "false") << " }";
+  }
+  os << "\n  ]\n";
+  os << "}\n";
+  return os.str();
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template bool GNSN_Simulator::Compare<TScalar>(GNSN_WProbCalcT<TScalar>&, double, GNSN_SimulationReport&) const;
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
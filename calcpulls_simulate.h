@@ -0,0 +1,118 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "calcpulls.h"
+
+// ---- #
+// Monte Carlo simulation of the banners, to check the calculated tables against,
+// --- and to try rules before writing the exact calculations for them.
+//
+// Each trial pulls on the character banner until it has seven copies and on the weapon banner until it has five,
+// --- and counts the pulls each copy took, by the same rules as "CalcSSRCharacter()" and "CalcSSRWeapon()".
+// Any number of fate points works here, since nothing is tabulated ahead.
+//
+// The random numbers come from a counter-based generator (Philox-4x32-10), keyed by the seed
+// --- and counted by trial, banner and pull, so a trial always pulls the same way,
+// --- whichever thread or lane runs it. Results are the same for any thread count.
+// The trials run in lanes, a fixed number of trials side by side with their state in arrays,
+// --- so one pull of every lane is the same short loop without branches, for the compiler to vectorize.
+// ---- #
+
+// A 4x32 block of random bits for a counter and key.
+struct GNSN_Philox
+{
+  static void Generate(const uint32_t counter[4], const uint32_t key[2], uint32_t result[4]);
+};
+
+// How well the simulated distribution of one table fits the calculated one.
+struct GNSN_SimulationCheck
+{
+  int conLevel = -1;          // The character level, or -1 for a weapon table.
+  int refLevel = -1;          // The weapon level, or -1 for a character table.
+
+  double mean = 0.0;          // Mean pulls of the trials,
+  double meanHalfWidth = 0.0; // --- give or take this much at the confidence asked for,
+  double meanExact = 0.0;     // --- against the mean of the table.
+
+  double cdfDistance = 0.0;   // The largest difference of the simulated and calculated CDF (Kolmogorov-Smirnov),
+  int cdfDistancePulls = 0;   // --- at this pull count,
+  double cdfHalfWidth = 0.0;  // --- where the simulated CDF is give or take this much (Wilson score interval),
+  double cdfBand = 0.0;       // --- and the most it may be anywhere at the confidence asked for (Dvoretzky-Kiefer-Wolfowitz).
+
+  bool passed = false;        // Both the mean and the CDF are within their bounds.
+};
+
+struct GNSN_SimulationReport
+{
+  uint64_t trials = 0;
+  uint64_t pulls = 0;         // Pulls simulated over all trials and both banners.
+  double seconds = 0.0;       // Spent simulating.
+  double z = 0.0;             // Standard deviations of the confidence asked for.
+  std::vector<GNSN_SimulationCheck> checks; // The character levels, the weapon levels, then the pairs.
+
+  bool Passed() const;
+  std::string ToJSON() const;
+};
+
+class GNSN_Simulator
+{
+private:
+  // Trials with each level on each pull count, indexed by pull count - 1.
+  struct Counts
+  {
+    std::vector<uint64_t> character[7];
+    std::vector<uint64_t> weapon[5];
+    std::vector<uint64_t> pair[7][5];
+    uint64_t pulls = 0;
+
+    void Reset(const GNSN_BannerRules& rules);
+    void Add(const Counts& other);
+  };
+
+private:
+  GNSN_BannerRules rules;
+
+  // Chance per pull count of a five-star, and the featured and specific rates, as thresholds for 32 random bits.
+  std::vector<uint64_t> charThreshold;
+  std::vector<uint64_t> weapThreshold;
+  uint64_t charFeatured;
+  uint64_t weapFeatured;
+  uint64_t weapSpecific;
+
+  Counts counts;
+  uint64_t trials = 0;
+  double seconds = 0.0;
+
+public:
+  explicit GNSN_Simulator(const GNSN_BannerRules& rules = GNSN_GenshinRules);
+
+  // Simulate "trials" more trials, numbered on from the ones before, so several runs add up to one long run.
+  // "threadCount" counts the calling thread, and 0 means one per hardware thread.
+  void Run(uint64_t trials, uint64_t seed, int threadCount = 0);
+
+  // Forget every trial.
+  void Reset();
+
+  const GNSN_BannerRules& GetBannerRules() const { return rules; }
+  uint64_t GetTrials() const { return trials; }
+  uint64_t GetPulls() const { return counts.pulls; }
+  double GetSeconds() const { return seconds; }
+
+  // Trials per pull count, indexed by pull count - 1, for the empirical distribution of a level.
+  const std::vector<uint64_t>& GetSSRCharacterCounts(int conLevel) const { return counts.character[conLevel]; }
+  const std::vector<uint64_t>& GetSSRWeaponCounts(int refLevel) const { return counts.weapon[refLevel]; }
+  const std::vector<uint64_t>& GetSSRPairCounts(int conLevel, int refLevel) const { return counts.pair[conLevel][refLevel]; }
+
+  // Check every table of "calc" against the trials, at a confidence of "z" standard deviations (3.29 for 99.9%) per table.
+  // Returns false for a calculator with other banner rules.
+  template<class TScalar>
+  bool Compare(GNSN_WProbCalcT<TScalar>& calc, double z, GNSN_SimulationReport& report) const;
+
+private:
+  // Pulls each copy arrived on, for "trialCount" trials from "firstTrial", 7 or 5 per trial.
+  void SimulateCharacter(uint64_t firstTrial, int trialCount, const uint32_t key[2], uint32_t* results) const;
+  void SimulateWeapon(uint64_t firstTrial, int trialCount, const uint32_t key[2], uint32_t* results) const;
+  GNSN_SimulationCheck Check(const std::vector<uint64_t>& levelCounts, const std::vector<double>& table, double z) const;
+};
\ No newline at end of file
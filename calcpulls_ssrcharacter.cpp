@@ -2,9 +2,11 @@
 #include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <type_traits>
 #include <mpir.h>
 
 #include "calcpulls.h"
+#include "calcpulls_convolve.h"
 
 // The documentation I, the programmer, read to make use of the "MPIR (Multiple Precision Integers and Rationals)" library that I decided to use.
 // [Link is compromised.]
@@ -14,153 +16,248 @@
 
 // This is for calculating the probabilities for five-star characters in Genshin Impact.
 // For this case, Genshin Impact five-star characters got labeled as "SSR"s.
-void GNSN_WProbCalc::CalcSSRCharacter()
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRCharacter()
 {
   if((initialized & 1) == 1)
     return;
 
-  // Use a default precision of at least 256 bits for the next MPF variables to be initialized.
-  mpf_set_default_prec(256);
+  // Every level, each one building on the one before.
+  for(int conLevel = 0; conLevel < 7; conLevel++)
+  {
+    this->CalcSSRCharacterLevel(conLevel);
+  }
+
+  initialized = (initialized | 1);
+}
+
+// Calculate the table of one level, after the levels below it that it depends on, unless it's there already.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRCharacterLevel(int conLevel)
+{
+  if((this->levelsSSRChar & (1 << conLevel)) != 0)
+    return;
+  if(conLevel > 0)
+    this->CalcSSRCharacterLevel(conLevel - 1);
+
+  int maxPullsForCon = this->CharacterPulls(conLevel);
+  if(conLevel == 0)
+  {
+    this->CalcSSRCharacterFirstCopy();
+  }
+  else
+  {
+    // The duplicates.
+    // Each level is the previous level convolved with the first copy:
+    // --- the probability for (1) this copy to have occured on (2) pull count B after (3) the previous copy occured on pull count A.
+    this->MarkPhase("character.duplicates", true);
+    this->ProbPL_SSRChar[conLevel] = this->arenaSSRChar.AllocateArray<Value>(maxPullsForCon);
+    TScalar::InitArray(this->ProbPL_SSRChar[conLevel], maxPullsForCon, this->precision, this->arenaSSRChar);
+    this->ConvolveSupported(
+      this->ProbPL_SSRChar[conLevel],                                          // Storage for pull count "A + B + 1" (both are stored as pull count - 1).
+      this->ProbPL_SSRChar[conLevel - 1], this->Support_SSRChar[conLevel - 1], // Probability for the previous specific five-star to have occured on pull count A.
+      this->ProbPL_SSRChar[0], this->Support_SSRChar[0]);                      // Probability for the specific five-star to occur on pull count B.
+    this->MarkPhase("character.duplicates", false);
+  }
+
+  // Where the table isn't zero, after dropping what the error budget allows from its tails.
+  // A level made from others is missing what they were missing too.
+  double inherited = (conLevel == 0) ? 0.0 : this->Support_SSRChar[conLevel - 1].discarded + this->Support_SSRChar[0].discarded;
+  this->Support_SSRChar[conLevel] = this->TrimTable(this->ProbPL_SSRChar[conLevel], maxPullsForCon, inherited);
+
+  // Cumulative probabilities.
+  this->MarkPhase("character.cumulative", true);
+  this->ProbCDF_SSRChar[conLevel] = this->arenaSSRChar.AllocateArray<Value>(maxPullsForCon);
+  TScalar::InitArray(this->ProbCDF_SSRChar[conLevel], maxPullsForCon, this->precision, this->arenaSSRChar);
+  CalcCumulative(this->ProbPL_SSRChar[conLevel], maxPullsForCon, this->Support_SSRChar[conLevel].discarded == 0.0, this->ProbCDF_SSRChar[conLevel]);
+  this->MarkPhase("character.cumulative", false);
+
+  this->levelsSSRChar = this->levelsSSRChar | (1 << conLevel);
+}
 
+// The source probabilities and their distribution, which only take the pity rules.
+// They have an arena of their own, so they stay when the rest of the banner's rules change (see "SetBannerRules()").
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRCharacterSource()
+{
   // Generic variables.
-  mpf_t gA, gB, gC;
-  mpf_init(gA);
-  mpf_init(gB);
-  mpf_init(gC);
+  Value gA, gB;
+  TScalar::Init(gA, this->precision);
+  TScalar::Init(gB, this->precision);
+
+  // The rules for any five-star.
+  const GNSN_PityRules& pity = this->rules.character.pity;
+  const int hardPity = pity.hardPity;
 
   // ----- #
   // Source probability.
   // Probability per pull count to pull any five-star.
   // ----- #
 
-  // Setup specific values.
-  mpf_set_d(gA, 6.0);
-  mpf_set_d(gB, 1000.0);
-  mpf_div(gA, gA, gB);   // 6 / 1000 = 0.006 (0.6%).
-                         // - Default probability for acquisition of a five-star per pull.
-  mpf_set_d(gC, 60.0);
-  mpf_div(gB, gC, gB); // 60 / 1000 = 0.06 (6%).
-                       // - Increment of probability for acquisition of a five-star per pull during "soft pity".
-
-  for(int pullCount = 0; pullCount < 90; pullCount++)
-  {
-    // Get and set the location to store the calculated probability.
-    mpf_t& tarMemAdd = this->ProbSrc_SSRChar[pullCount];
-    mpf_init(tarMemAdd); mpf_set_d(tarMemAdd, 0.0);
+  this->MarkPhase("character.source", true);
 
-    // Get and set the probability for any five-star to occur on this pull count.
-    if(pullCount == 89)
-    {
-      // Guaranteed for a five-star to occur.
-      mpf_set_d(tarMemAdd, 1.0);
-    }
-    else if(pullCount > 72)
+  // The stock rules have their source tables made at compile time (see "calcpulls_rules.h"),
+  // --- which a calculator on doubles can take as they are.
+  const bool stockTables = std::is_same<Value, double>::value && pity == GNSN_GenshinRules.character.pity;
+
+  this->ProbSrc_SSRChar = this->arenaSrcSSRChar.AllocateArray<Value>(hardPity);
+  TScalar::InitArray(this->ProbSrc_SSRChar, hardPity, this->precision, this->arenaSrcSSRChar);
+  if(stockTables)
+  {
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
     {
-      // Soft pity.
-      // While not the last pull before a 100% probability, and is after 72 (the 73rd pull),
-      // - consider it as "soft pity" where each pull after the 0th has an increased probability.
-      // Intended hard-coded limit for the increase of probability through soft pity:
-      // - (88 - 72) * 0.06 + 0.006 equals 0.966, which is less than 100%.
-      // - So, no need to adjust the check for setting the probability to 100%.
-      mpf_set_d(tarMemAdd, pullCount - 72); // Get the number of pulls done in soft pity.
-      mpf_mul(tarMemAdd, tarMemAdd, gB);    // Multiply it with the base increment value.
-      mpf_add(tarMemAdd, tarMemAdd, gA);    // Add the original rate for acquisition of any five star.
+      TScalar::SetD(this->ProbSrc_SSRChar[pullCount], GNSN_GenshinCharacterSource.source[pullCount]);
     }
-    else
+  }
+  else
+  {
+    // Setup specific values.
+    this->SetRate(gA, pity.baseRate);          // 6 / 1000 = 0.006 (0.6%) for the stock rules.
+                                               // - Default probability for acquisition of a five-star per pull.
+    this->SetRate(gB, pity.softPityIncrement); // 60 / 1000 = 0.06 (6%) for the stock rules.
+                                               // - Increment of probability for acquisition of a five-star per pull during "soft pity".
+
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
     {
-      // The base rate for acqusition of any five star.
-      mpf_set(tarMemAdd, gA);
+      // Get and set the location to store the calculated probability.
+      Value& tarMemAdd = this->ProbSrc_SSRChar[pullCount];
+
+      // Get and set the probability for any five-star to occur on this pull count.
+      if(pullCount == hardPity - 1)
+      {
+        // Guaranteed for a five-star to occur.
+        TScalar::SetD(tarMemAdd, 1.0);
+      }
+      else if(pullCount > pity.softPity)
+      {
+        // Soft pity.
+        // While not the last pull before a 100% probability, and is after 72 (the 73rd pull) for the stock rules,
+        // - consider it as "soft pity" where each pull after the 0th has an increased probability.
+        // For the stock rules, (88 - 72) * 0.06 + 0.006 equals 0.966, which is less than 100%,
+        // - but other rules can climb past it before hard pity, so it stops at 100%.
+        TScalar::SetD(tarMemAdd, pullCount - pity.softPity); // Get the number of pulls done in soft pity.
+        TScalar::Mul(tarMemAdd, tarMemAdd, gB);              // Multiply it with the base increment value.
+        TScalar::Add(tarMemAdd, tarMemAdd, gA);              // Add the original rate for acquisition of any five star.
+        if(TScalar::CmpD(tarMemAdd, 1.0) > 0)
+          TScalar::SetD(tarMemAdd, 1.0);
+      }
+      else
+      {
+        // The base rate for acqusition of any five star.
+        TScalar::Set(tarMemAdd, gA);
+      }
     }
   }
 
+  this->MarkPhase("character.source", false);
+
   // ----- #
   // Source distribution of probabilities.
   // ----- #
 
-  // Setup specific values.
-  mpf_set_d(gA, 1.0); // Remainining population, where 100% is yet to acquire a five-star.
+  this->MarkPhase("character.sourceDist", true);
 
-  // Calculate the probabilities for which pull count a five-star will specifically occur on.
-  for(int pullCount = 0; pullCount < 90; pullCount++)
+  this->ProbSrcDist_SSRChar = this->arenaSrcSSRChar.AllocateArray<Value>(hardPity);
+  TScalar::InitArray(this->ProbSrcDist_SSRChar, hardPity, this->precision, this->arenaSrcSSRChar);
+  if(stockTables)
   {
-    // Get and set the percentage who acquired a five-star.
-    mpf_t& tarMemAdd = this->ProbSrcDist_SSRChar[pullCount];
-    mpf_init(tarMemAdd);
-    mpf_mul(tarMemAdd, this->ProbSrc_SSRChar[pullCount], gA);
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
+    {
+      TScalar::SetD(this->ProbSrcDist_SSRChar[pullCount], GNSN_GenshinCharacterSource.sourceDist[pullCount]);
+    }
+  }
+  else
+  {
+    // Setup specific values.
+    TScalar::SetD(gA, 1.0); // Remainining population, where 100% is yet to acquire a five-star.
 
-    // Subtract the percentage who acquired a five-star from the remaining population.
-    mpf_sub(gA, gA, tarMemAdd);
+    // Calculate the probabilities for which pull count a five-star will specifically occur on.
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
+    {
+      // Get and set the percentage who acquired a five-star.
+      Value& tarMemAdd = this->ProbSrcDist_SSRChar[pullCount];
+      TScalar::Mul(tarMemAdd, this->ProbSrc_SSRChar[pullCount], gA);
+
+      // Subtract the percentage who acquired a five-star from the remaining population.
+      TScalar::Sub(gA, gA, tarMemAdd);
+    }
   }
 
+  this->MarkPhase("character.sourceDist", false);
+
+  this->sourcesSSR = this->sourcesSSR | 1;
+
+  // Clean memory of temporary variables.
+  TScalar::Clear(gA);
+  TScalar::Clear(gB);
+}
+
+// The first copy (level 0), after the source probabilities and their distribution.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRCharacterFirstCopy()
+{
+  if((this->sourcesSSR & 1) == 0)
+    this->CalcSSRCharacterSource();
+  const int hardPity = this->rules.character.pity.hardPity;
+
+  // Generic variables.
+  Value gA, gB, gC;
+  TScalar::Init(gA, this->precision);
+  TScalar::Init(gB, this->precision);
+  TScalar::Init(gC, this->precision);
+
   // ----- #
   // Base probability.
   // Probability per pull count to pull the specific event-wish featured five-star.
   // ----- #
 
   // Setup specific values.
-  mpf_set_d(gA, 0.5); // The probability for both winning and losing a 50/50.
+  this->SetRate(gA, this->rules.character.featuredRate); // The probability for winning a 50/50.
+  TScalar::SetD(gC, 1.0);
+  TScalar::Sub(gC, gC, gA);                              // The probability for losing it.
 
   // Initialize relevant memory.
-  for(int conLevel = 0; conLevel < 7; conLevel++)
-  {
-    int maxPullsForCon = (conLevel + 1) * 180;
-    this->ProbPL_SSRChar[conLevel] = new mpf_t[maxPullsForCon];
-    for(int pullCount = 0; pullCount < maxPullsForCon; pullCount++)
-    {
-      mpf_init(this->ProbPL_SSRChar[conLevel][pullCount]);
-      mpf_set_d(this->ProbPL_SSRChar[conLevel][pullCount], 0.0);
-    }
-  }
+  // The other levels get theirs when they are calculated.
+  const int maxPullsForFirst = this->CharacterPulls(0);
+  this->ProbPL_SSRChar[0] = this->arenaSSRChar.AllocateArray<Value>(maxPullsForFirst);
+  TScalar::InitArray(this->ProbPL_SSRChar[0], maxPullsForFirst, this->precision, this->arenaSSRChar);
 
   // The first copy.
+  this->MarkPhase("character.firstCopy", true);
   // Calculate the probabilities for which pull count the first copy of a specific event-wish featured five-star could occur on.
   // Calculate the probabilities for which pull count the first five-star could occur on.
-  for(int pullCountA = 0; pullCountA < 90; pullCountA++)
+  for(int pullCountA = 0; pullCountA < hardPity; pullCountA++)
   {
-    mpf_t& pSrcDistA = this->ProbSrcDist_SSRChar[pullCountA];
+    Value& pSrcDistA = this->ProbSrcDist_SSRChar[pullCountA];
     // Calculate the probabilities for which pull count the second five-star, which is the guaranteed (after "losing the 50/50") five-star, could occur on.
-    for(int pullCountB = 0; pullCountB < 90; pullCountB++)
+    for(int pullCountB = 0; pullCountB < hardPity; pullCountB++)
     {
-      mpf_t& tarMemAdd = this->ProbPL_SSRChar[0][pullCountA + pullCountB + 1];
-      mpf_t& pSrcDistB = this->ProbSrcDist_SSRChar[pullCountB];
-      mpf_mul(gB, gA, pSrcDistA);        // Get the probability for the first five-star to have occured and became a failed 50/50.
-      mpf_mul(gB, gB, pSrcDistB);        // Set the probability for this guaranteed five-star to occur on this pull count.
-      mpf_add(tarMemAdd, tarMemAdd, gB); // Add the probability to storage.
+      Value& tarMemAdd = this->ProbPL_SSRChar[0][pullCountA + pullCountB + 1];
+      Value& pSrcDistB = this->ProbSrcDist_SSRChar[pullCountB];
+      TScalar::Mul(gB, gC, pSrcDistA);        // Get the probability for the first five-star to have occured and became a failed 50/50.
+      TScalar::Mul(gB, gB, pSrcDistB);        // Set the probability for this guaranteed five-star to occur on this pull count.
+      TScalar::Add(tarMemAdd, tarMemAdd, gB); // Add the probability to storage.
     }
 
     // Add the probability for this pull count to have yielded a won 50/50 to storage.
-    mpf_t& tarMemAdd = this->ProbPL_SSRChar[0][pullCountA];
-    mpf_mul(gB, gA, this->ProbSrcDist_SSRChar[pullCountA]);
-    mpf_add(tarMemAdd, tarMemAdd, gB);
+    Value& tarMemAdd = this->ProbPL_SSRChar[0][pullCountA];
+    TScalar::Mul(gB, gA, this->ProbSrcDist_SSRChar[pullCountA]);
+    TScalar::Add(tarMemAdd, tarMemAdd, gB);
   }
 
-  // The duplicates.
-  // Calculate the probabilities for which pull count each constellation level could occur on.
-  for(int conLevel = 1; conLevel < 7; conLevel++)
-  {
-    // Iterate through the possible pull counts for the previous constellation level.
-    for(int pullCountA = 0; pullCountA < conLevel * 180; pullCountA++)
-    {
-      // Iterate through the possible pull counts for the target constellation level.
-      for(int pullCountB = 0; pullCountB < 180; pullCountB++)
-      {
-        // Set the probability for (1) this copy to have occured on (2) this pull count after (3) the pull count for the previous copy.
-        mpf_mul(gA,                                      // Generic storage variable.
-          this->ProbPL_SSRChar[0][pullCountB],           // Probability for the specific five-star to occur on pull count B.
-          this->ProbPL_SSRChar[conLevel - 1][pullCountA] // Probability for the previous specific five-star to have occured on pull count A.
-        );
-
-        // Add the probability to storage.
-        mpf_t& tarMemAdd = this->ProbPL_SSRChar[conLevel][pullCountA + pullCountB + 1];
-        mpf_add(tarMemAdd, tarMemAdd, gA);
-      }
-    }
-  }
-
-  initialized = (initialized | 1);
+  this->MarkPhase("character.firstCopy", false);
 
   // Clean memory of temporary variables.
-  mpf_clear(gA);
-  mpf_clear(gB);
-  mpf_clear(gC);
+  TScalar::Clear(gA);
+  TScalar::Clear(gB);
+  TScalar::Clear(gC);
 }
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRCharacter(); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRCharacterLevel(int); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRCharacterSource(); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRCharacterFirstCopy();
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
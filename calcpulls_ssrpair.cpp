@@ -2,11 +2,14 @@
 #include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <vector>
 #include <mpir.h>
 
 #include "calcpulls.h"
+#include "calcpulls_convolve.h"
 
-void GNSN_WProbCalc::CalcSSRPair()
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRPair()
 {
   // Make sure dependencies are there.
   if((initialized & 1) != 1)
@@ -22,47 +25,130 @@ void GNSN_WProbCalc::CalcSSRPair()
     return;
   }
 
-  mpf_set_default_prec(256);
+  this->MarkPhase("pair.cells", true);
 
-  // Generic variables.
-  mpf_t gA;
-  mpf_init(gA);
-
-  // Initialize relevant memory.
-  for(int conLevel = 0; conLevel < 7; conLevel++)
+  // Initialize relevant memory, for the cells that weren't already calculated on their own.
+  // The arena isn't shared between threads, so this happens before any of them start.
+  std::vector<int> cells;
+  for(int cell = 0; cell < 7 * 5; cell++)
   {
-    for(int refLevel = 0; refLevel < 5; refLevel++)
-    {
-      int maxPulls = (conLevel + 1) * 180 + (refLevel + 1) * 240;
-      mpf_t*& tarMemAdd = this->ProbPL_SSRPair[conLevel][refLevel];
-      tarMemAdd = new mpf_t[maxPulls];
-      for(int pullCount = 0; pullCount < maxPulls; pullCount++)
-      {
-        mpf_init(tarMemAdd[pullCount]);
-        mpf_set_d(tarMemAdd[pullCount], 0.0);
-      }
-    }
+    if((this->cellsSSRPair & ((uint64_t)1 << cell)) != 0)
+      continue;
+    this->AllocSSRPairCell(cell / 5, cell % 5);
+    cells.push_back(cell);
   }
 
   // Calculate probabilities.
-  for(int conLevel = 0; conLevel < 7; conLevel++)
+  // Every cell is independent of the others, so with more than one thread they are shared out, the longest first.
+  if(this->threadCount == 1)
   {
-    for(int refLevel = 0; refLevel < 5; refLevel++)
+    for(int cell : cells)
     {
-      for(int pullCountA = 0; pullCountA < (conLevel + 1) * 180; pullCountA++)
-      {
-        for(int pullCountB = 0; pullCountB < (refLevel + 1) * 240; pullCountB++)
-        {
-          mpf_mul(gA,
-            this->ProbPL_SSRChar[conLevel][pullCountA],
-            this->ProbPL_SSRWeap[refLevel][pullCountB]);
-          mpf_t& tarMemAdd = this->ProbPL_SSRPair[conLevel][refLevel][pullCountA + pullCountB + 1];
-          mpf_add(tarMemAdd, tarMemAdd, gA);
-        }
-      }
+      this->CalcSSRPairCell(cell / 5, cell % 5);
     }
   }
+  else
+  {
+    if(!this->threadPool)
+      this->threadPool.reset(new GNSN_ThreadPool(this->threadCount));
+
+    std::stable_sort(cells.begin(), cells.end(), [this](int a, int b) { return this->PairPulls(a / 5, a % 5) > this->PairPulls(b / 5, b % 5); });
+
+    this->threadPool->Run((int)cells.size(), [this, &cells](int task) {
+      this->CalcSSRPairCell(cells[task] / 5, cells[task] % 5);
+    });
+  }
+  for(int cell : cells)
+    this->cellsSSRPair = this->cellsSSRPair | ((uint64_t)1 << cell);
+
+  this->MarkPhase("pair.cells", false);
 
-  mpf_clear(gA);
   initialized = initialized | 4;
-}
\ No newline at end of file
+}
+
+// Calculate one cell on its own, with only the character level and weapon level it needs, unless it's there already.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRPairLevel(int conLevel, int refLevel)
+{
+  const uint64_t cellBit = (uint64_t)1 << (conLevel * 5 + refLevel);
+  if((this->cellsSSRPair & cellBit) != 0)
+    return;
+
+  this->CalcSSRCharacterLevel(conLevel);
+  this->CalcSSRWeaponLevel(refLevel);
+
+  this->MarkPhase("pair.cells", true);
+  this->AllocSSRPairCell(conLevel, refLevel);
+  this->CalcSSRPairCell(conLevel, refLevel);
+  this->cellsSSRPair = this->cellsSSRPair | cellBit;
+  this->MarkPhase("pair.cells", false);
+}
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::AllocSSRPairCell(int conLevel, int refLevel)
+{
+  int maxPulls = this->PairPulls(conLevel, refLevel);
+  Value*& tarMemAdd = this->ProbPL_SSRPair[conLevel][refLevel];
+  tarMemAdd = this->arenaSSRPair.AllocateArray<Value>(maxPulls);
+  TScalar::InitArray(tarMemAdd, maxPulls, this->precision, this->arenaSSRPair);
+  this->ProbCDF_SSRPair[conLevel][refLevel] = this->arenaSSRPair.AllocateArray<Value>(maxPulls);
+  TScalar::InitArray(this->ProbCDF_SSRPair[conLevel][refLevel], maxPulls, this->precision, this->arenaSSRPair);
+}
+
+// Pulling for the pair takes pull count A on the character banner plus pull count B on the weapon banner.
+// Each level goes into five or seven cells, so its transforms are kept for the others.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRPairCell(int conLevel, int refLevel)
+{
+  this->ConvolveSupported(
+    this->ProbPL_SSRPair[conLevel][refLevel],
+    this->ProbPL_SSRChar[conLevel], this->Support_SSRChar[conLevel],
+    this->ProbPL_SSRWeap[refLevel], this->Support_SSRWeap[refLevel],
+    &this->spectraSSRChar, &this->spectraSSRWeap);
+
+  int maxPulls = this->PairPulls(conLevel, refLevel);
+  double inherited = this->Support_SSRChar[conLevel].discarded + this->Support_SSRWeap[refLevel].discarded;
+  this->Support_SSRPair[conLevel][refLevel] = this->TrimTable(this->ProbPL_SSRPair[conLevel][refLevel], maxPulls, inherited);
+
+  // Cumulative probabilities.
+  CalcCumulative(this->ProbPL_SSRPair[conLevel][refLevel], maxPulls, this->Support_SSRPair[conLevel][refLevel].discarded == 0.0, this->ProbCDF_SSRPair[conLevel][refLevel]);
+}
+
+template<class TScalar>
+const typename TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRCharacterTable(int conLevel)
+{
+  if(conLevel < 0 || conLevel >= 7)
+    return nullptr;
+  this->CalcSSRCharacterLevel(conLevel);
+  return this->ProbPL_SSRChar[conLevel];
+}
+
+template<class TScalar>
+const typename TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRWeaponTable(int refLevel)
+{
+  if(refLevel < 0 || refLevel >= 5)
+    return nullptr;
+  this->CalcSSRWeaponLevel(refLevel);
+  return this->ProbPL_SSRWeap[refLevel];
+}
+
+template<class TScalar>
+const typename TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRPairTable(int conLevel, int refLevel)
+{
+  if(conLevel < 0 || conLevel >= 7 || refLevel < 0 || refLevel >= 5)
+    return nullptr;
+  this->CalcSSRPairLevel(conLevel, refLevel);
+  return this->ProbPL_SSRPair[conLevel][refLevel];
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRPair(); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRPairCell(int, int); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRPairLevel(int, int); \
+  template void GNSN_WProbCalcT<TScalar>::AllocSSRPairCell(int, int); \
+  template const TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRCharacterTable(int); \
+  template const TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRWeaponTable(int); \
+  template const TScalar::Value* GNSN_WProbCalcT<TScalar>::GetSSRPairTable(int, int);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
@@ -2,9 +2,12 @@
 #include <fstream>
 #include <iomanip>
 #include <algorithm>
+#include <vector>
+#include <type_traits>
 #include <mpir.h>
 
 #include "calcpulls.h"
+#include "calcpulls_convolve.h"
 
 // The documentation I, the programmer, read to make use of the "MPIR (Multiple Precision Integers and Rationals)" library that I decided to use.
 // [Link is compromised.]
@@ -23,219 +26,320 @@ double getNumber(const mpf_t& target)
 
 // This is for calculating the probabilities for five-star weapons in Genshin Impact.
 // For this case, Genshin Impact five-star weapons got labeled as "SSR"s.
-void GNSN_WProbCalc::CalcSSRWeapon()
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRWeapon()
 {
   if((initialized & 2) == 2)
     return;
 
-  // Use a default precision of at least 256 bits for the next MPF variables to be initialized.
-  mpf_set_default_prec(256);
-  
+  // Every level, each one building on the one before.
+  for(int refineLevel = 0; refineLevel < 5; refineLevel++)
+  {
+    this->CalcSSRWeaponLevel(refineLevel);
+  }
+
+  initialized = (initialized | 2);
+}
 
+// Calculate the table of one level, after the levels below it that it depends on, unless it's there already.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponLevel(int refineLevel)
+{
+  if((this->levelsSSRWeap & (1 << refineLevel)) != 0)
+    return;
+  if(refineLevel > 0)
+    this->CalcSSRWeaponLevel(refineLevel - 1);
+
+  int maxPullsForRefine = this->WeaponPulls(refineLevel);
+  if(refineLevel == 0)
+  {
+    this->CalcSSRWeaponFirstCopy();
+  }
+  else
+  {
+    // The duplicates.
+    // Each level is the previous level convolved with the first copy:
+    // --- the probability for (1) this copy to have occured on (2) pull count B after (3) the previous copy occured on pull count A.
+    this->MarkPhase("weapon.duplicates", true);
+    this->ProbPL_SSRWeap[refineLevel] = this->arenaSSRWeap.AllocateArray<Value>(maxPullsForRefine);
+    TScalar::InitArray(this->ProbPL_SSRWeap[refineLevel], maxPullsForRefine, this->precision, this->arenaSSRWeap);
+    this->ConvolveSupported(
+      this->ProbPL_SSRWeap[refineLevel],                                             // Storage for pull count "A + B + 1" (both are stored as pull count - 1).
+      this->ProbPL_SSRWeap[refineLevel - 1], this->Support_SSRWeap[refineLevel - 1], // Probability for the previous specific five-star to have occured on pull count A.
+      this->ProbPL_SSRWeap[0], this->Support_SSRWeap[0]);                            // Probability for the specific five-star to occur on pull count B.
+    this->MarkPhase("weapon.duplicates", false);
+  }
+
+  // Where the table isn't zero, after dropping what the error budget allows from its tails.
+  // A level made from others is missing what they were missing too.
+  double inherited = (refineLevel == 0) ? 0.0 : this->Support_SSRWeap[refineLevel - 1].discarded + this->Support_SSRWeap[0].discarded;
+  this->Support_SSRWeap[refineLevel] = this->TrimTable(this->ProbPL_SSRWeap[refineLevel], maxPullsForRefine, inherited);
+
+  // Cumulative probabilities.
+  this->MarkPhase("weapon.cumulative", true);
+  this->ProbCDF_SSRWeap[refineLevel] = this->arenaSSRWeap.AllocateArray<Value>(maxPullsForRefine);
+  TScalar::InitArray(this->ProbCDF_SSRWeap[refineLevel], maxPullsForRefine, this->precision, this->arenaSSRWeap);
+  CalcCumulative(this->ProbPL_SSRWeap[refineLevel], maxPullsForRefine, this->Support_SSRWeap[refineLevel].discarded == 0.0, this->ProbCDF_SSRWeap[refineLevel]);
+  this->MarkPhase("weapon.cumulative", false);
+
+  this->levelsSSRWeap = this->levelsSSRWeap | (1 << refineLevel);
+}
+
+// The source probabilities and their distribution, which only take the pity rules.
+// They have an arena of their own, so they stay when the rest of the banner's rules change (see "SetBannerRules()").
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponSource()
+{
   // Generic variables.
-  mpf_t gA, gB, gC, gD, gE, gF, gG, gH;
-  mpf_init(gA);
-  mpf_init(gB);
-  mpf_init(gC);
-  mpf_init(gD);
-  mpf_init(gE);
-  mpf_init(gF);
-  mpf_init(gG);
-  mpf_init(gH);
+  Value gA, gB;
+  TScalar::Init(gA, this->precision);
+  TScalar::Init(gB, this->precision);
+
+  // The rules for any five-star.
+  const GNSN_PityRules& pity = this->rules.weapon.pity;
+  const int hardPity = pity.hardPity;
 
   // ----- #
   // Source probability.
   // Probability per pull count to pull any five-star.
   // ----- #
-  
-  // Setup specific values.
-  mpf_set_d(gA, 7.0);
-  mpf_set_d(gB, 1000.0);
-  mpf_div(gA, gA, gB);   // 7 / 1000 = 0.007 (0.7%).
-                         // - Default probability for acquisition of a five-star per pull.
-  mpf_set_d(gC, 70.0);
-  mpf_div(gB, gC, gB); // 70 / 1000 = 0.07 (7%).
-                       // - Increment of probability for acquisition of a five-star per pull during "soft pity".
-
-  for(int pullCount = 0; pullCount < 80; pullCount++)
-  {
-    // Get and set the location to store the calculated probability.
-    mpf_t& tarMemAdd = this->ProbSrc_SSRWeap[pullCount];
-    mpf_init(tarMemAdd); mpf_set_d(tarMemAdd, 0.0);
 
-    // Get and set the probability for any five-star to occur on this pull count.
-    if(pullCount > 75)
-    {
-      // Guaranteed for a five-star to occur.
-      mpf_set_d(tarMemAdd, 1.0);
-    }
-    else if(pullCount > 61)
+  this->MarkPhase("weapon.source", true);
+
+  // The stock rules have their source tables made at compile time (see "calcpulls_rules.h"),
+  // --- which a calculator on doubles can take as they are.
+  const bool stockTables = std::is_same<Value, double>::value && pity == GNSN_GenshinRules.weapon.pity;
+
+  this->ProbSrc_SSRWeap = this->arenaSrcSSRWeap.AllocateArray<Value>(hardPity);
+  TScalar::InitArray(this->ProbSrc_SSRWeap, hardPity, this->precision, this->arenaSrcSSRWeap);
+  if(stockTables)
+  {
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
     {
-      // Soft pity.
-      // While not the last pull before a 100% probability, and is after 61 (the 62nd pull),
-      // - consider it as "soft pity" where each pull after the 0th has an increased probability.
-      // Intended hard-coded limit for the increase of probability through soft pity:
-      // - (78 - 61) * 0.07 + 0.007 equals 1.127, which is more than 100%.
-      // - | (x - 61) * 0.07 + 0.007 = 1
-      // - |                       x = (1 - 0.007) / 0.07 + 61
-      // - |                       x = ~75.19
-      // - After the 75th iteration (76th pull), the chance is greater than 100%. 
-      mpf_set_d(tarMemAdd, pullCount - 61); // Get the number of pulls done in soft pity.
-      mpf_mul(tarMemAdd, tarMemAdd, gB);    // Multiply it with the base increment value.
-      mpf_add(tarMemAdd, tarMemAdd, gA);    // Add the original rate for acquisition of any five star.
+      TScalar::SetD(this->ProbSrc_SSRWeap[pullCount], GNSN_GenshinWeaponSource.source[pullCount]);
     }
-    else
+  }
+  else
+  {
+    // Setup specific values.
+    this->SetRate(gA, pity.baseRate);          // 7 / 1000 = 0.007 (0.7%) for the stock rules.
+                                               // - Default probability for acquisition of a five-star per pull.
+    this->SetRate(gB, pity.softPityIncrement); // 70 / 1000 = 0.07 (7%) for the stock rules.
+                                               // - Increment of probability for acquisition of a five-star per pull during "soft pity".
+
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
     {
-      // The base rate for acqusition of any five star.
-      mpf_set(tarMemAdd, gA);
+      // Get and set the location to store the calculated probability.
+      Value& tarMemAdd = this->ProbSrc_SSRWeap[pullCount];
+
+      // Get and set the probability for any five-star to occur on this pull count.
+      if(pullCount == hardPity - 1)
+      {
+        // Guaranteed for a five-star to occur.
+        TScalar::SetD(tarMemAdd, 1.0);
+      }
+      else if(pullCount > pity.softPity)
+      {
+        // Soft pity.
+        // While not the last pull before a 100% probability, and is after 61 (the 62nd pull) for the stock rules,
+        // - consider it as "soft pity" where each pull after the 0th has an increased probability.
+        // For the stock rules, (78 - 61) * 0.07 + 0.007 equals 1.127, which is more than 100%.
+        // - | (x - 61) * 0.07 + 0.007 = 1
+        // - |                       x = (1 - 0.007) / 0.07 + 61
+        // - |                       x = ~75.19
+        // - After the 75th iteration (76th pull), the chance is greater than 100%, so it stops at 100%.
+        TScalar::SetD(tarMemAdd, pullCount - pity.softPity); // Get the number of pulls done in soft pity.
+        TScalar::Mul(tarMemAdd, tarMemAdd, gB);              // Multiply it with the base increment value.
+        TScalar::Add(tarMemAdd, tarMemAdd, gA);              // Add the original rate for acquisition of any five star.
+        if(TScalar::CmpD(tarMemAdd, 1.0) > 0)
+          TScalar::SetD(tarMemAdd, 1.0);
+      }
+      else
+      {
+        // The base rate for acqusition of any five star.
+        TScalar::Set(tarMemAdd, gA);
+      }
     }
   }
 
+  this->MarkPhase("weapon.source", false);
+
   // ----- #
   // Source distribution of probabilities.
   // ----- #
 
-  // Setup specific values.
-  mpf_set_d(gA, 1.0); // Remainining population, where 100% is yet to acquire a five-star.
+  this->MarkPhase("weapon.sourceDist", true);
 
-  // Calculate the probabilities for which pull count a five-star will specifically occur on.
-  for(int pullCount = 0; pullCount < 80; pullCount++)
+  this->ProbSrcDist_SSRWeap = this->arenaSrcSSRWeap.AllocateArray<Value>(hardPity);
+  TScalar::InitArray(this->ProbSrcDist_SSRWeap, hardPity, this->precision, this->arenaSrcSSRWeap);
+  if(stockTables)
+  {
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
+    {
+      TScalar::SetD(this->ProbSrcDist_SSRWeap[pullCount], GNSN_GenshinWeaponSource.sourceDist[pullCount]);
+    }
+  }
+  else
   {
-    // Get and set the percentage who acquired a five-star.
-    mpf_t& tarMemAdd = this->ProbSrcDist_SSRWeap[pullCount];
-    mpf_init(tarMemAdd);
-    mpf_mul(tarMemAdd, this->ProbSrc_SSRWeap[pullCount], gA);
+    // Setup specific values.
+    TScalar::SetD(gA, 1.0); // Remainining population, where 100% is yet to acquire a five-star.
 
-    // Subtract the percentage who acquired a five-star from the remaining population.
-    mpf_sub(gA, gA, tarMemAdd);
+    // Calculate the probabilities for which pull count a five-star will specifically occur on.
+    for(int pullCount = 0; pullCount < hardPity; pullCount++)
+    {
+      // Get and set the percentage who acquired a five-star.
+      Value& tarMemAdd = this->ProbSrcDist_SSRWeap[pullCount];
+      TScalar::Mul(tarMemAdd, this->ProbSrc_SSRWeap[pullCount], gA);
+
+      // Subtract the percentage who acquired a five-star from the remaining population.
+      TScalar::Sub(gA, gA, tarMemAdd);
+    }
   }
 
-  // ----- #
-  // Base probability.
-  // Probability per pull count to pull the specific event-wish featured five-star.
-  // ----- #
+  this->MarkPhase("weapon.sourceDist", false);
 
-  // Setup specific values.
-  mpf_set_d(gA, 0.5);  // Store in "gA", the probability for both winning and losing a 50/50.
-  mpf_set_d(gB, 3);    // Numerator.
-  mpf_set_d(gC, 4);    // Denominator.
-  mpf_div(gB, gB, gC); // Store in "gB", 3 / 4 = 75% chance to get one of the two featured five-star.
-  mpf_mul(gC, gA, gB); // Store in "gC", 0.75 * 0.5 = 37.5% chance to be the specific five-star.
-                       // - Coincidentally, it's also 37.5% chance to be one of the featured five-star, but not be the specific five-star.
-
-  mpf_mul(gD,          // Probability for second five-star to be the specific five-star when the first was a featured five-star.
-    gB,                // - 75% probability for first to be a featured five-star.
-    gA);               // - 50% probability for the first to not be the specific five-star.
-  mpf_mul(gD,          // 
-    gD,                // 
-    gC);               // - 37.5% probability for the second to be the specific five-star.
-  mpf_set_d(gE, 1.0);  //
-  mpf_sub(gE, gE, gB); // 25% chance to not be one of the two featured five-star.
-  mpf_mul(gE,          // Probability for second five-star to be the specific five-star when the second was not a featured five-star.
-    gE,                // - 25% probability for first to not be a featured five-star.
-    gA);               // - 50% probability for second to be the specific five-star.
-
-  // Probability for second five-star to be the specific five-star.
-  mpf_add(gD, gD, gE); // 0.75 * 0.5 * 0.375 + 0.25 * 0.5 = 0.265625 (26.5625%) 
-
-  // Get the probability for the second five-star to not be the specific five-star.
-  mpf_set_d(gF, 1.0);  //
-  mpf_sub(gF, gF, gC); // 1 - 0.375 = 0.625 (62.5%)
-                       // - probability for the second five-star to not be the specific five-star after the first was not a featured five-star.
-  mpf_mul(gG,          //
-    gB,                // 75% probability for the first to be a featured five-star.
-    gA);               // 50% probability for the first to not be the specific five-star.
-  mpf_mul(gG,          //
-    gG,                //
-    gF);               // 62.5% probability for the second to not be the specific five-star.
-  mpf_add(gE, gE, gG); // Probability for the second five-star to not be the specific five-star.
+  this->sourcesSSR = this->sourcesSSR | 2;
+
+  // Clean memory of temporary variables.
+  TScalar::Clear(gA);
+  TScalar::Clear(gB);
+}
+
+// The first copy (level 0), after the source probabilities and their distribution.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponFirstCopy()
+{
+  if((this->sourcesSSR & 2) == 0)
+    this->CalcSSRWeaponSource();
+  const int hardPity = this->rules.weapon.pity.hardPity;
 
   // Initialize relevant memory.
-  for(int refineLevel = 0; refineLevel < 5; refineLevel++)
-  {
-    int maxPullsForRefine = (refineLevel + 1) * 240;
-    this->ProbPL_SSRWeap[refineLevel] = new mpf_t[maxPullsForRefine];
-    for(int pullCount = 0; pullCount < maxPullsForRefine; pullCount++)
-    {
-      mpf_init(this->ProbPL_SSRWeap[refineLevel][pullCount]);
-      mpf_set_d(this->ProbPL_SSRWeap[refineLevel][pullCount], 0.0);
-    }
-  }
+  // The other levels get theirs when they are calculated.
+  const int maxPullsForFirst = this->WeaponPulls(0);
+  this->ProbPL_SSRWeap[0] = this->arenaSSRWeap.AllocateArray<Value>(maxPullsForFirst);
+  TScalar::InitArray(this->ProbPL_SSRWeap[0], maxPullsForFirst, this->precision, this->arenaSSRWeap);
 
   // The first copy.
-  // Calculate the probabilities for which pull count the first copy of a specific event-wish featured five-star could occur on.
-  // Calculate the probabilities for which pull count the first five-star could occur on.
-  for(int pullCountA = 0; pullCountA < 80; pullCountA++)
-  {
-    mpf_t& pSrcDistA = this->ProbSrcDist_SSRWeap[pullCountA];
-    // Calculate the probabilities for which pull count the second five-star could occur on.
-    for(int pullCountB = 0; pullCountB < 80; pullCountB++)
-    {
-      mpf_t& pSrcDistB = this->ProbSrcDist_SSRWeap[pullCountB];
+  // Calculate the probabilities for which pull count the first copy of a specific event-wish featured five-star could occur on,
+  // --- following the five-stars from zero pity and no fate points.
+  this->MarkPhase("weapon.firstCopy", true);
+  this->CalcSSRWeaponStates(this->ProbSrcDist_SSRWeap, hardPity, 0, false, this->ProbPL_SSRWeap[0]);
+  this->MarkPhase("weapon.firstCopy", false);
+}
 
-      // For the third five-star.
-      // Probability for the second five-star to not be the specific five-star.
-      mpf_mul(gF, gE, pSrcDistA); // - With probability for the first to occur.
-      mpf_mul(gF, gF, pSrcDistB); // - With probability for the second to occur.
+// The five-stars of the weapon banner as a state machine, for the pull count the specific five-star occurs on.
+// The state of a five-star is its fate points and whether it's guaranteed to be a featured one,
+// --- and "pending[fatePoints][guaranteed]" holds the probabilities for which pull count it occurs on in that state.
+// A five-star is the specific one with the rates of its state, and ends there. Otherwise the next five-star
+// --- (the pity counter starting over, so one convolution with the source distribution) is in the state with one more fate point,
+// --- guaranteed to be featured after a standard five-star. At the rules' fate points, the five-star is the specific one for sure.
+// Going through the states in order of fate points, each is done once, so this takes one convolution per state,
+// --- for any number of fate points.
+// "nextDist" has the probabilities for which pull count the next five-star occurs on, "nextCount" of them,
+// --- and the next five-star has "fatePoints" and "guaranteed". "first" gets the first copy added to it.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponStates(const Value* nextDist, int nextCount, int fatePoints, bool guaranteed, Value* first)
+{
+  const int hardPity = this->rules.weapon.pity.hardPity;
+  const int maxFatePoints = this->rules.weapon.fatePoints;
+  const int firstCount = this->WeaponPulls(0);
 
-      // Calculate the probabilities for which pull count the third five-star could occur on.
-      for(int pullCountC = 0; pullCountC < 80; pullCountC++)
-      {
-        mpf_t& tarMemAdd = this->ProbPL_SSRWeap[0][pullCountA + pullCountB + pullCountC + 2];
-        mpf_mul(gH,                               // Store in "gH", the product of the following:
-          gF,                                     // - (1) Probability for the second five-star to have occurred and for there yet to be the specific five-star.
-          this->ProbSrcDist_SSRWeap[pullCountC]); // - (2) Probability for this third five-star to occur.
-        mpf_add(tarMemAdd, tarMemAdd, gH);        // Add the probability to storage.
-      }
+  GNSN_Arena scratch;
+  Value gA, gB, gC, gD;
+  TScalar::Init(gA, this->precision);
+  TScalar::Init(gB, this->precision);
+  TScalar::Init(gC, this->precision);
+  TScalar::Init(gD, this->precision);
 
-      // Add the probability for this pull count to be the specific five-star to storage.
-      mpf_t& tarMemAdd = this->ProbPL_SSRWeap[0][pullCountA + pullCountB + 1];
-      // Probability for the second five-star to be the specific five-star after both
-      // - (1) the first five-star failed to be a featured five-star, and
-      // - (2) the first five-star was a featured five-star but not the specific five-star...
-      mpf_mul(gF, gD, pSrcDistA); // - With probability for the first to occur.
-      mpf_mul(gF, gF, pSrcDistB); // - With probability for the second to occur.
-      mpf_add(tarMemAdd, tarMemAdd, gF);
-    }
+  // Each five-star occurs at most hard pity (80) pulls after the last, and there are at most "maxFatePoints + 1" of them.
+  std::vector<Value*> pending((size_t)(maxFatePoints + 1) * 2);
+  for(Value*& dist : pending)
+  {
+    dist = scratch.AllocateArray<Value>(firstCount);
+    TScalar::InitArray(dist, firstCount, this->precision, scratch);
+  }
+  Value* next = scratch.AllocateArray<Value>(firstCount);
+  TScalar::InitArray(next, firstCount, this->precision, scratch);
 
-    // Add the probability for this pull count to be the specific five-star.
-    mpf_t& tarMemAdd = this->ProbPL_SSRWeap[0][pullCountA];
-    mpf_mul(gF, gC, pSrcDistA);
-    mpf_add(tarMemAdd, tarMemAdd, gF);
+  // The next five-star.
+  for(int pullCount = 0; pullCount < nextCount; pullCount++)
+  {
+    TScalar::Set(pending[fatePoints * 2 + (guaranteed ? 1 : 0)][pullCount], nextDist[pullCount]);
   }
 
-  // The duplicates.
-  // Calculate the probabilities for which pull count each refinement rank could occur on.
-  for(int refineLevel = 1; refineLevel < 5; refineLevel++)
+  // Follow the five-stars that aren't the specific five-star, through the fate points.
+  int pendingCount = nextCount;
+  for(int fate = fatePoints; fate <= maxFatePoints; fate++)
   {
-    // Iterate through the possible pull counts for the previous constellation level.
-    for(int pullCountA = 0; pullCountA < refineLevel * 240; pullCountA++)
+    for(int guarantee = 0; guarantee < 2; guarantee++)
     {
-      // Iterate through the possible pull counts for the target constellation level.
-      for(int pullCountB = 0; pullCountB < 240; pullCountB++)
+      Value* dist = pending[fate * 2 + guarantee];
+
+      // With all the fate points, the five-star is the specific five-star.
+      if(fate == maxFatePoints)
+      {
+        for(int pullCount = 0; pullCount < pendingCount; pullCount++)
+        {
+          TScalar::Add(first[pullCount], first[pullCount], dist[pullCount]);
+        }
+        continue;
+      }
+
+      // With the stock rules:
+      // --- With a guarantee: 50% to be the specific five-star, 50% to be the other featured five-star.
+      // --- Without:          37.5% to be the specific five-star, 37.5% to be the other featured five-star, 25% to be a standard five-star.
+      this->SetRate(gA, this->rules.weapon.specificRate); // Store in "gA", the probability to be the specific five-star.
+      TScalar::SetD(gC, 1.0);
+      TScalar::Sub(gC, gC, gA);                           // Store in "gC", the probability to be the other featured five-star.
+      TScalar::SetD(gD, 0.0);                             // Store in "gD", the probability to be a standard five-star.
+      if(!guarantee)
+      {
+        this->SetRate(gD, this->rules.weapon.featuredRate);
+        TScalar::Mul(gA, gA, gD);
+        TScalar::Mul(gC, gC, gD);
+        TScalar::SetD(gB, 1.0);
+        TScalar::Sub(gD, gB, gD);
+      }
+      for(int pullCount = 0; pullCount < pendingCount; pullCount++)
+      {
+        TScalar::Mul(gB, dist[pullCount], gA);
+        TScalar::Add(first[pullCount], first[pullCount], gB);
+      }
+
+      // The five-star after it, with one more fate point.
+      for(int pullCount = 0; pullCount < firstCount; pullCount++)
+      {
+        TScalar::SetD(next[pullCount], 0.0);
+      }
+      GNSN_Convolution<TScalar>::Accumulate(next, dist, pendingCount, this->ProbSrcDist_SSRWeap, hardPity, 1, this->precision);
+      for(int pullCount = 0; pullCount < pendingCount + hardPity; pullCount++)
       {
-        // Set the probability for (1) this copy to have occured on (2) this pull count after (3) the pull count for the previous copy.
-        mpf_mul(gA,                                         // Generic storage variable.
-          this->ProbPL_SSRWeap[0][pullCountB],              // Probability for the specific five-star to occur on pull count B.
-          this->ProbPL_SSRWeap[refineLevel - 1][pullCountA] // Probability for the previous specific five-star to have occured on pull count A.
-        );
-
-        // Add the probability to storage.
-        mpf_t& tarMemAdd = this->ProbPL_SSRWeap[refineLevel][pullCountA + pullCountB + 1];
-        mpf_add(tarMemAdd, tarMemAdd, gA);
+        TScalar::Mul(gB, next[pullCount], gC);
+        Value& tarMemAdd = pending[(fate + 1) * 2][pullCount];
+        TScalar::Add(tarMemAdd, tarMemAdd, gB);
+        if(!guarantee)
+        {
+          TScalar::Mul(gB, next[pullCount], gD);
+          Value& tarMemAddStd = pending[(fate + 1) * 2 + 1][pullCount];
+          TScalar::Add(tarMemAddStd, tarMemAddStd, gB);
+        }
       }
     }
+    pendingCount += hardPity;
   }
 
-  initialized = (initialized | 2);
-
-  // Clean memory of temporary variables.
-  mpf_clear(gA);
-  mpf_clear(gB);
-  mpf_clear(gC);
-  mpf_clear(gD);
-  mpf_clear(gE);
-  mpf_clear(gF);
-  mpf_clear(gG);
-  mpf_clear(gH);
+  TScalar::Clear(gA);
+  TScalar::Clear(gB);
+  TScalar::Clear(gC);
+  TScalar::Clear(gD);
 }
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRWeapon(); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponLevel(int); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponSource(); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponFirstCopy(); \
+  template void GNSN_WProbCalcT<TScalar>::CalcSSRWeaponStates(const TScalar::Value*, int, int, bool, TScalar::Value*);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
\ No newline at end of file
@@ -0,0 +1,132 @@
+#include <sstream>
+
+#include "calcpulls_stats.h"
+
+static void WriteOpCounts(std::ostream& os, const GNSN_OpCounts& ops)
+{
+  os << "\"mul\": " << ops.mul
+    << ", \"add\": " << ops.add
+    << ", \"allocCount\": " << ops.allocCount
+    << ", \"allocBytes\": " << ops.allocBytes;
+}
+
+std::string GNSN_CalcStats::ToJSON() const
+{
+  std::ostringstream os;
+  os << "{\n";
+  os << "  \"seconds\": " << seconds << ",\n";
+  os << "  \"ops\": { ";
+  WriteOpCounts(os, ops);
+  os << " },\n";
+  os << "  \"tableBytes\": " << tableBytes << ",\n";
+  os << "  \"tableBlocks\": " << tableBlocks << ",\n";
+  os << "  \"mappedBytes\": " << mappedBytes << ",\n";
+  os << "  \"phases\": [";
+  for(size_t index = 0; index < phases.size(); index++)
+  {
+    const GNSN_PhaseStats& phase = phases[index];
+    os << (index == 0 ? "\n" : ",\n");
+    os << "    { \"name\": \"" << phase.name << "\", \"runs\": " << phase.runs << ", \"seconds\": " << phase.seconds << ", ";
+    WriteOpCounts(os, phase.ops);
+    os << " }";
+  }
+  os << "\n  ]\n";
+  os << "}\n";
+  return os.str();
+}
+
+#ifdef GNSN_WPROBCALC_STATS
+
+thread_local GNSN_OpCounters* gnsnOpCounters = nullptr;
+
+#endif
+
+
+
+// ---- #
+// Statistics of "GNSN_WProbCalcT".
+// ---- #
+
+#ifdef GNSN_WPROBCALC_STATS
+#include <cstring>
+#include "calcpulls.h"
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::RecordPhase(const char* phase, bool starting)
+{
+  if(starting)
+  {
+    // The calling thread counts into this calculator while any of its phases runs.
+    if(this->openPhases.empty())
+    {
+      this->countersBefore = gnsnOpCounters;
+      gnsnOpCounters = &this->opCounters;
+    }
+    this->openPhases.push_back(OpenPhase{ phase, std::chrono::steady_clock::now(), this->opCounters.Get() });
+    return;
+  }
+
+  // Find the phase that is ending, normally the last one started.
+  for(size_t open = this->openPhases.size(); open-- > 0; )
+  {
+    if(std::strcmp(this->openPhases[open].name, phase) != 0)
+      continue;
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->openPhases[open].start).count();
+    const GNSN_OpCounts before = this->openPhases[open].ops;
+    const GNSN_OpCounts after = this->opCounters.Get();
+    GNSN_OpCounts ops;
+    ops.mul = after.mul - before.mul;
+    ops.add = after.add - before.add;
+    ops.allocCount = after.allocCount - before.allocCount;
+    ops.allocBytes = after.allocBytes - before.allocBytes;
+    this->openPhases.erase(this->openPhases.begin() + open);
+    if(this->openPhases.empty())
+      gnsnOpCounters = this->countersBefore;
+
+    GNSN_PhaseStats* entry = nullptr;
+    for(GNSN_PhaseStats& known : this->stats.phases)
+    {
+      if(known.name == phase)
+        entry = &known;
+    }
+    if(entry == nullptr)
+    {
+      this->stats.phases.push_back(GNSN_PhaseStats());
+      entry = &this->stats.phases.back();
+      entry->name = phase;
+    }
+    entry->runs++;
+    entry->seconds += seconds;
+    entry->ops.Add(ops);
+    this->stats.seconds += seconds;
+    this->stats.ops.Add(ops);
+    return;
+  }
+}
+
+template<class TScalar>
+const GNSN_CalcStats& GNSN_WProbCalcT<TScalar>::GetStats()
+{
+  this->stats.tableBytes = this->arenaSSRChar.GetBytesAllocated() + this->arenaSSRWeap.GetBytesAllocated() + this->arenaSSRPair.GetBytesAllocated()
+    + this->arenaSrcSSRChar.GetBytesAllocated() + this->arenaSrcSSRWeap.GetBytesAllocated();
+  this->stats.tableBlocks = this->arenaSSRChar.GetBlockCount() + this->arenaSSRWeap.GetBlockCount() + this->arenaSSRPair.GetBlockCount()
+    + this->arenaSrcSSRChar.GetBlockCount() + this->arenaSrcSSRWeap.GetBlockCount();
+  this->stats.mappedBytes = this->mappedTables ? this->mappedTables->GetSize() : 0;
+  return this->stats;
+}
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::ResetStats()
+{
+  this->stats.Reset();
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::RecordPhase(const char*, bool); \
+  template const GNSN_CalcStats& GNSN_WProbCalcT<TScalar>::GetStats(); \
+  template void GNSN_WProbCalcT<TScalar>::ResetStats();
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
+#endif
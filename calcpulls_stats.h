@@ -0,0 +1,99 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ---- #
+// Statistics of the calculations, to see where time and memory go without a profiler.
+// Only collected when "GNSN_WPROBCALC_STATS" is defined; otherwise the counters and timers aren't compiled in at all,
+// --- and "GNSN_WProbCalcT" has no "GetStats()".
+// Each calculator counts its own operations: while one of its phases runs, the calling thread and the threads of its pool
+// --- count into that calculator's counters, so calculators on other threads don't add to them.
+// ---- #
+
+// Counts of scalar operations and of memory taken for values.
+struct GNSN_OpCounts
+{
+  uint64_t mul = 0;        // "Mul()" and "Div()".
+  uint64_t add = 0;        // "Add()", "Sub()" and "AddFixed()".
+  uint64_t allocCount = 0; // MPF values (and temporaries) given limbs.
+  uint64_t allocBytes = 0; // Bytes of those limbs.
+
+  void Add(const GNSN_OpCounts& other)
+  {
+    mul += other.mul;
+    add += other.add;
+    allocCount += other.allocCount;
+    allocBytes += other.allocBytes;
+  }
+};
+
+struct GNSN_PhaseStats
+{
+  std::string name; // As given to "GNSN_PhaseObserver".
+  int runs = 0;     // Times the phase ran since the stats were reset.
+  double seconds = 0.0;
+  GNSN_OpCounts ops;
+};
+
+struct GNSN_CalcStats
+{
+  std::vector<GNSN_PhaseStats> phases; // In the order they first ran.
+  double seconds = 0.0;                 // All phases together.
+  GNSN_OpCounts ops;                    // All phases together.
+
+  // Table footprint, as of the last "GetStats()".
+  uint64_t tableBytes = 0;  // Handed out by the arenas of the tables.
+  uint64_t tableBlocks = 0; // Blocks the arenas took from the heap.
+  uint64_t mappedBytes = 0; // Size of the table file mapped by "LoadTables()".
+
+  void Reset() { *this = GNSN_CalcStats(); }
+  std::string ToJSON() const;
+};
+
+#ifdef GNSN_WPROBCALC_STATS
+// Counters of one calculator.
+// The threads of its pool count into them at the same time, so they are atomic.
+class GNSN_OpCounters
+{
+public:
+  std::atomic<uint64_t> mul{ 0 };
+  std::atomic<uint64_t> add{ 0 };
+  std::atomic<uint64_t> allocCount{ 0 };
+  std::atomic<uint64_t> allocBytes{ 0 };
+
+public:
+  GNSN_OpCounts Get() const
+  {
+    GNSN_OpCounts counts;
+    counts.mul = mul.load(std::memory_order_relaxed);
+    counts.add = add.load(std::memory_order_relaxed);
+    counts.allocCount = allocCount.load(std::memory_order_relaxed);
+    counts.allocBytes = allocBytes.load(std::memory_order_relaxed);
+    return counts;
+  }
+};
+
+// The counters the calling thread's operations go to, or null to count nothing.
+extern thread_local GNSN_OpCounters* gnsnOpCounters;
+
+// Counts the calling thread's operations into "counters" until it goes out of scope.
+class GNSN_OpCountScope
+{
+private:
+  GNSN_OpCounters* previous;
+
+public:
+  explicit GNSN_OpCountScope(GNSN_OpCounters* counters) : previous(gnsnOpCounters) { gnsnOpCounters = counters; }
+  ~GNSN_OpCountScope() { gnsnOpCounters = previous; }
+
+  GNSN_OpCountScope(const GNSN_OpCountScope&) = delete;
+  GNSN_OpCountScope& operator=(const GNSN_OpCountScope&) = delete;
+};
+
+#define GNSN_STATS_COUNT(field, amount) \
+  do { if(gnsnOpCounters) gnsnOpCounters->field.fetch_add((uint64_t)(amount), std::memory_order_relaxed); } while(0)
+#else
+#define GNSN_STATS_COUNT(field, amount) ((void)0)
+#endif
@@ -0,0 +1,157 @@
+#include <iostream>
+#include <algorithm>
+#include <mpir.h>
+
+#include "calcpulls.h"
+#include "calcpulls_convolve.h"
+
+// Support of the tables, and trimming their tails within the error budget.
+// The tables are probability distributions over pull counts, so every value is at least 0,
+// --- and the mass dropped from a table shows up at most once in each table made from it by convolution.
+
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::SetErrorBudget(double epsilon)
+{
+  if(epsilon < 0.0)
+    epsilon = 0.0;
+  if(epsilon == this->errorBudget)
+    return;
+
+  this->Clean();
+  this->errorBudget = epsilon;
+}
+
+// Where "table" isn't zero.
+template<class TScalar>
+GNSN_TableSupport GNSN_WProbCalcT<TScalar>::FindSupport(const Value* table, int count)
+{
+  GNSN_TableSupport support;
+  int lo = 0;
+  while(lo < count && TScalar::CmpD(table[lo], 0.0) == 0)
+    lo++;
+  int hi = count - 1;
+  while(hi >= lo && TScalar::CmpD(table[hi], 0.0) == 0)
+    hi--;
+  support.lo = lo;
+  support.hi = hi;
+  return support;
+}
+
+// Find where "table" isn't zero, then (with an error budget) zero out the smallest values at each end,
+// --- as long as no more than half the budget is dropped from each end.
+template<class TScalar>
+GNSN_TableSupport GNSN_WProbCalcT<TScalar>::TrimTable(Value* table, int count, double inherited) const
+{
+  GNSN_TableSupport support = FindSupport(table, count);
+  support.discarded = inherited;
+
+  int lo = support.lo;
+  int hi = support.hi;
+  if(this->errorBudget > 0.0 && lo <= hi)
+  {
+    const double sideBudget = this->errorBudget * 0.5;
+    double dropped = 0.0;
+    while(hi > lo && dropped + TScalar::GetD(table[hi]) <= sideBudget)
+    {
+      dropped += TScalar::GetD(table[hi]);
+      TScalar::SetD(table[hi--], 0.0);
+    }
+    double droppedLow = 0.0;
+    while(lo < hi && droppedLow + TScalar::GetD(table[lo]) <= sideBudget)
+    {
+      droppedLow += TScalar::GetD(table[lo]);
+      TScalar::SetD(table[lo++], 0.0);
+    }
+    support.discarded += dropped + droppedLow;
+  }
+
+  support.lo = lo;
+  support.hi = hi;
+  return support;
+}
+
+// "target[i + j + 1] += a[i] * b[j]", for "i" and "j" in the supports only.
+// The caches, if given, keep the transforms of "a" and "b" for their next convolutions.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::ConvolveSupported(Value* target, const Value* a, const GNSN_TableSupport& supportA, const Value* b, const GNSN_TableSupport& supportB,
+  GNSN_SpectrumCache<TScalar>* cacheA, GNSN_SpectrumCache<TScalar>* cacheB) const
+{
+  if(supportA.IsEmpty() || supportB.IsEmpty())
+    return;
+
+  GNSN_Convolution<TScalar>::Accumulate(
+    target,
+    a + supportA.lo, supportA.GetCount(),
+    b + supportB.lo, supportB.GetCount(),
+    supportA.lo + supportB.lo + 1,
+    this->precision,
+    cacheA, cacheB);
+}
+
+// Tables from a file only have their values, so the supports are found again,
+// --- and what they are missing is what the last cumulative probability is short of 1.
+template<class TScalar>
+void GNSN_WProbCalcT<TScalar>::FindLoadedSupports()
+{
+  for(int conLevel = 0; conLevel < 7 && (this->initialized & 1) == 1; conLevel++)
+  {
+    const int count = this->CharacterPulls(conLevel);
+    this->Support_SSRChar[conLevel] = FindSupport(this->ProbPL_SSRChar[conLevel], count);
+    this->Support_SSRChar[conLevel].discarded = std::max(0.0, 1.0 - TScalar::GetD(this->ProbCDF_SSRChar[conLevel][count - 1]));
+  }
+  for(int refLevel = 0; refLevel < 5 && (this->initialized & 2) == 2; refLevel++)
+  {
+    const int count = this->WeaponPulls(refLevel);
+    this->Support_SSRWeap[refLevel] = FindSupport(this->ProbPL_SSRWeap[refLevel], count);
+    this->Support_SSRWeap[refLevel].discarded = std::max(0.0, 1.0 - TScalar::GetD(this->ProbCDF_SSRWeap[refLevel][count - 1]));
+  }
+  for(int cell = 0; cell < 7 * 5 && (this->initialized & 4) == 4; cell++)
+  {
+    const int conLevel = cell / 5;
+    const int refLevel = cell % 5;
+    const int count = this->PairPulls(conLevel, refLevel);
+    this->Support_SSRPair[conLevel][refLevel] = FindSupport(this->ProbPL_SSRPair[conLevel][refLevel], count);
+    this->Support_SSRPair[conLevel][refLevel].discarded = std::max(0.0, 1.0 - TScalar::GetD(this->ProbCDF_SSRPair[conLevel][refLevel][count - 1]));
+  }
+}
+
+template<class TScalar>
+GNSN_TableSupport GNSN_WProbCalcT<TScalar>::GetSSRCharacterSupport(int conLevel)
+{
+  if(conLevel < 0 || conLevel >= 7)
+    return GNSN_TableSupport();
+  this->CalcSSRCharacterLevel(conLevel);
+  return this->Support_SSRChar[conLevel];
+}
+
+template<class TScalar>
+GNSN_TableSupport GNSN_WProbCalcT<TScalar>::GetSSRWeaponSupport(int refLevel)
+{
+  if(refLevel < 0 || refLevel >= 5)
+    return GNSN_TableSupport();
+  this->CalcSSRWeaponLevel(refLevel);
+  return this->Support_SSRWeap[refLevel];
+}
+
+template<class TScalar>
+GNSN_TableSupport GNSN_WProbCalcT<TScalar>::GetSSRPairSupport(int conLevel, int refLevel)
+{
+  if(conLevel < 0 || conLevel >= 7 || refLevel < 0 || refLevel >= 5)
+    return GNSN_TableSupport();
+  this->CalcSSRPairLevel(conLevel, refLevel);
+  return this->Support_SSRPair[conLevel][refLevel];
+}
+
+// Instantiate for every scalar policy.
+#define GNSN_INSTANTIATE(TScalar) \
+  template void GNSN_WProbCalcT<TScalar>::SetErrorBudget(double); \
+  template GNSN_TableSupport GNSN_WProbCalcT<TScalar>::FindSupport(const TScalar::Value*, int); \
+  template GNSN_TableSupport GNSN_WProbCalcT<TScalar>::TrimTable(TScalar::Value*, int, double) const; \
+  template void GNSN_WProbCalcT<TScalar>::ConvolveSupported(TScalar::Value*, const TScalar::Value*, const GNSN_TableSupport&, const TScalar::Value*, const GNSN_TableSupport&, \
+    GNSN_SpectrumCache<TScalar>*, GNSN_SpectrumCache<TScalar>*) const; \
+  template void GNSN_WProbCalcT<TScalar>::FindLoadedSupports(); \
+  template GNSN_TableSupport GNSN_WProbCalcT<TScalar>::GetSSRCharacterSupport(int); \
+  template GNSN_TableSupport GNSN_WProbCalcT<TScalar>::GetSSRWeaponSupport(int); \
+  template GNSN_TableSupport GNSN_WProbCalcT<TScalar>::GetSSRPairSupport(int, int);
+GNSN_WPROBCALC_FOR_EACH_SCALAR(GNSN_INSTANTIATE)
+#undef GNSN_INSTANTIATE
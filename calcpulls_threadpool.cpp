@@ -0,0 +1,135 @@
+#include "calcpulls_threadpool.h"
+
+GNSN_ThreadPool::GNSN_ThreadPool(int threadCount)
+{
+  if(threadCount <= 0)
+    threadCount = HardwareThreads();
+
+  for(int worker = 0; worker < threadCount; worker++)
+    this->queues.emplace_back(new Queue());
+
+  // Worker 0 is whichever thread calls "Run()".
+  for(int worker = 1; worker < threadCount; worker++)
+    this->threads.emplace_back(&GNSN_ThreadPool::WorkerMain, this, worker);
+}
+
+GNSN_ThreadPool::~GNSN_ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->stopping = true;
+  }
+  this->wake.notify_all();
+  for(std::thread& thread : this->threads)
+    thread.join();
+}
+
+int GNSN_ThreadPool::HardwareThreads()
+{
+  const int count = (int)std::thread::hardware_concurrency();
+  return (count > 0) ? count : 1;
+}
+
+void GNSN_ThreadPool::Run(int taskCount, const std::function<void(int)>& function)
+{
+  if(taskCount <= 0)
+    return;
+
+  // The task has to be in place before any index shows up in a queue,
+  // --- as a thread still finishing the previous run may pick the index up right away.
+  {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->task = &function;
+    this->error = nullptr;
+    this->remaining = taskCount;
+    this->generation++;
+#ifdef GNSN_WPROBCALC_STATS
+    this->counters = gnsnOpCounters;
+#endif
+  }
+
+  // Deal the tasks out like cards, so each queue starts with a share of the long and the short tasks.
+  const int queueCount = (int)this->queues.size();
+  for(int index = 0; index < taskCount; index++)
+  {
+    Queue& queue = *this->queues[index % queueCount];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    queue.tasks.push_front(index);
+  }
+  this->wake.notify_all();
+
+  Work(0);
+
+  std::unique_lock<std::mutex> lock(this->mutex);
+  this->finished.wait(lock, [this]() { return this->remaining == 0; });
+  this->task = nullptr;
+  if(this->error)
+    std::rethrow_exception(this->error);
+}
+
+void GNSN_ThreadPool::WorkerMain(int worker)
+{
+  int seenGeneration = 0;
+  for(;;)
+  {
+#ifdef GNSN_WPROBCALC_STATS
+    GNSN_OpCounters* counters = nullptr;
+#endif
+    {
+      std::unique_lock<std::mutex> lock(this->mutex);
+      this->wake.wait(lock, [&]() { return this->stopping || this->generation != seenGeneration; });
+      if(this->stopping)
+        return;
+      seenGeneration = this->generation;
+#ifdef GNSN_WPROBCALC_STATS
+      counters = this->counters;
+#endif
+    }
+#ifdef GNSN_WPROBCALC_STATS
+    GNSN_OpCountScope scope(counters);
+#endif
+    Work(worker);
+  }
+}
+
+void GNSN_ThreadPool::Work(int worker)
+{
+  int index = 0;
+  while(TakeTask(worker, index))
+  {
+    try
+    {
+      (*this->task)(index);
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(this->mutex);
+      if(!this->error)
+        this->error = std::current_exception();
+    }
+
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if(--this->remaining == 0)
+      this->finished.notify_all();
+  }
+}
+
+bool GNSN_ThreadPool::TakeTask(int worker, int& index)
+{
+  const int queueCount = (int)this->queues.size();
+
+  // Take from our own queue first, then steal from the others.
+  // Either way take from the back, where the lowest (longest) remaining task is.
+  for(int offset = 0; offset < queueCount; offset++)
+  {
+    Queue& queue = *this->queues[(worker + offset) % queueCount];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if(queue.tasks.empty())
+      continue;
+
+    index = queue.tasks.back();
+    queue.tasks.pop_back();
+    return true;
+  }
+  return false;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "calcpulls_stats.h"
+
+// ---- #
+// A small work-stealing thread pool.
+// Each thread has its own queue of task indices. A thread takes from its own queue,
+// --- and when that is empty, steals from the other queues, so uneven tasks still keep every thread busy.
+// The thread calling "Run()" works as one of the threads.
+// ---- #
+
+class GNSN_ThreadPool
+{
+private:
+  struct Queue
+  {
+    std::mutex mutex;
+    std::deque<int> tasks;
+  };
+
+private:
+  std::vector<std::thread> threads;
+  std::vector<std::unique_ptr<Queue>> queues;
+
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::condition_variable finished;
+  const std::function<void(int)>* task = nullptr;
+  std::exception_ptr error;
+  int generation = 0;
+  int remaining = 0;
+  bool stopping = false;
+#ifdef GNSN_WPROBCALC_STATS
+  GNSN_OpCounters* counters = nullptr; // What the thread calling "Run()" counts into, for the other threads to count into too.
+#endif
+
+public:
+  // "threadCount" counts the calling thread, and 0 means one per hardware thread.
+  explicit GNSN_ThreadPool(int threadCount);
+  ~GNSN_ThreadPool();
+
+  GNSN_ThreadPool(const GNSN_ThreadPool&) = delete;
+  GNSN_ThreadPool& operator=(const GNSN_ThreadPool&) = delete;
+
+  int GetThreadCount() const { return (int)queues.size(); }
+
+  // Call "function(index)" for every index from 0 to "taskCount - 1", and return when all calls are done.
+  // Lower indices get picked up first, so put the longest tasks first.
+  // The first exception thrown by a task is thrown again from here.
+  void Run(int taskCount, const std::function<void(int)>& function);
+
+  static int HardwareThreads();
+
+private:
+  void WorkerMain(int worker);
+  void Work(int worker);
+  bool TakeTask(int worker, int& index);
+};
@@ -0,0 +1,227 @@
+#include <algorithm>
+#include <iomanip>
+
+#include "calcpulls_timeline.h"
+
+// Timeline of banner phases, see "calcpulls_timeline.h".
+
+GNSN_Timeline::GNSN_Timeline()
+{
+  this->Reset(GNSN_PullState(), GNSN_PullState());
+}
+
+bool GNSN_Timeline::Reset(const GNSN_PullState& characterState, const GNSN_PullState& weaponState)
+{
+  if(characterState.pity < 0 || weaponState.pity < 0 || weaponState.fatePoints < 0)
+    return false;
+
+  const GNSN_PullState* states[2] = { &characterState, &weaponState };
+  for(int banner = 0; banner < 2; banner++)
+  {
+    BannerState& state = this->banners[banner];
+    state.pityCount = states[banner]->pity + 1;
+    state.probabilities.assign((size_t)4 * state.pityCount, 0.0);
+    state.probabilities[(size_t)(2 + (states[banner]->guaranteed ? 1 : 0)) * state.pityCount + states[banner]->pity] = 1.0;
+    state.fatePoints = (banner == GNSN_TimelineWeapon) ? weaponState.fatePoints : 0;
+  }
+  this->results.clear();
+  return true;
+}
+
+bool GNSN_Timeline::AddPhase(const GNSN_TimelinePhase& phase, GNSN_TimelineResult* result)
+{
+  if(phase.copies < 1 || phase.pulls < 0 || !phase.rules.Validate())
+    return false;
+
+  const bool weapon = phase.banner == GNSN_TimelineWeapon;
+  const GNSN_PityRules& pity = weapon ? phase.rules.weapon.pity : phase.rules.character.pity;
+  const int hardPity = pity.hardPity;
+  const int maxFatePoints = weapon ? phase.rules.weapon.fatePoints : 0;
+  const int copies = phase.copies;
+  const std::vector<double>& rates = this->GetRates(pity);
+
+  // What a five-star is, for each fate points and guarantee: a copy, another featured five-star or a standard five-star,
+  // --- the same as "CalcSSRCharacterFirstCopy()" and "CalcSSRWeaponStates()".
+  // The character banner has no fate points, and losing its 50/50 is the standard five-star.
+  const int fateCount = maxFatePoints + 1;
+  std::vector<double> toCopy((size_t)fateCount * 2), toFeatured((size_t)fateCount * 2), toStandard((size_t)fateCount * 2);
+  for(int fate = 0; fate < fateCount; fate++)
+  {
+    for(int guarantee = 0; guarantee < 2; guarantee++)
+    {
+      const size_t outcome = (size_t)fate * 2 + guarantee;
+      if(!weapon)
+      {
+        toCopy[outcome] = guarantee ? 1.0 : phase.rules.character.featuredRate.ToDouble();
+        toStandard[outcome] = 1.0 - toCopy[outcome];
+      }
+      else if(fate == maxFatePoints)
+      {
+        toCopy[outcome] = 1.0;
+      }
+      else
+      {
+        const double featured = guarantee ? 1.0 : phase.rules.weapon.featuredRate.ToDouble();
+        const double specific = phase.rules.weapon.specificRate.ToDouble();
+        toCopy[outcome] = featured * specific;
+        toFeatured[outcome] = featured * (1.0 - specific);
+        toStandard[outcome] = 1.0 - featured;
+      }
+    }
+  }
+
+  // The states within the phase, one block of pity counts per "((onTrack * copies + copy) * fateCount + fate) * 2 + guaranteed".
+  const int blockCount = 2 * copies * fateCount * 2;
+  auto block = [&](int onTrack, int copy, int fate, int guarantee) {
+    return (size_t)(((onTrack * copies + copy) * fateCount + fate) * 2 + guarantee) * hardPity;
+  };
+  std::vector<double> current((size_t)blockCount * hardPity, 0.0), next((size_t)blockCount * hardPity, 0.0);
+
+  // Carried over, with the pity capped to this phase's hard pity.
+  BannerState& state = this->banners[phase.banner];
+  const int startFate = std::min(state.fatePoints, maxFatePoints);
+  for(int onTrack = 0; onTrack < 2; onTrack++)
+  {
+    for(int guarantee = 0; guarantee < 2; guarantee++)
+    {
+      const double* carried = &state.probabilities[(size_t)(onTrack * 2 + guarantee) * state.pityCount];
+      double* start = &current[block(onTrack, 0, startFate, guarantee)];
+      for(int pullCount = 0; pullCount < state.pityCount; pullCount++)
+        start[std::min(pullCount, hardPity - 1)] += carried[pullCount];
+    }
+  }
+
+  // One pull at a time. Reaching the target stops pulling, with zero pity and no guarantee.
+  double reached[2] = { 0.0, 0.0 };
+  double expectedPulls = 0.0;
+  for(int pull = 0; pull < phase.pulls; pull++)
+  {
+    double pulling = 0.0;
+    for(double probability : current)
+      pulling += probability;
+    if(pulling <= 0.0)
+      break;
+    expectedPulls += pulling;
+
+    std::fill(next.begin(), next.end(), 0.0);
+    for(int onTrack = 0; onTrack < 2; onTrack++)
+    {
+      for(int copy = 0; copy < copies; copy++)
+      {
+        for(int fate = 0; fate < fateCount; fate++)
+        {
+          for(int guarantee = 0; guarantee < 2; guarantee++)
+          {
+            const double* from = &current[block(onTrack, copy, fate, guarantee)];
+            double* to = &next[block(onTrack, copy, fate, guarantee)];
+            double fiveStar = 0.0;
+            for(int pullCount = 0; pullCount < hardPity - 1; pullCount++)
+            {
+              const double hit = from[pullCount] * rates[pullCount];
+              fiveStar += hit;
+              to[pullCount + 1] += from[pullCount] - hit;
+            }
+            fiveStar += from[hardPity - 1];
+            if(fiveStar == 0.0)
+              continue;
+
+            const size_t outcome = (size_t)fate * 2 + guarantee;
+            if(copy + 1 == copies)
+              reached[onTrack] += fiveStar * toCopy[outcome];
+            else
+              next[block(onTrack, copy + 1, 0, 0)] += fiveStar * toCopy[outcome];
+            if(fate + 1 < fateCount || !weapon)
+            {
+              const int nextFate = weapon ? fate + 1 : 0;
+              next[block(onTrack, copy, nextFate, 0)] += fiveStar * toFeatured[outcome];
+              next[block(onTrack, copy, nextFate, 1)] += fiveStar * toStandard[outcome];
+            }
+          }
+        }
+      }
+    }
+    current.swap(next);
+  }
+
+  // Back to pity and guarantee. Whatever didn't reach the target is off track from here.
+  std::vector<double> carried((size_t)4 * hardPity, 0.0);
+  carried[(size_t)0 * hardPity] += reached[0];
+  carried[(size_t)2 * hardPity] += reached[1];
+  for(int onTrack = 0; onTrack < 2; onTrack++)
+  {
+    for(int copy = 0; copy < copies; copy++)
+    {
+      for(int fate = 0; fate < fateCount; fate++)
+      {
+        for(int guarantee = 0; guarantee < 2; guarantee++)
+        {
+          const double* from = &current[block(onTrack, copy, fate, guarantee)];
+          double* to = &carried[(size_t)guarantee * hardPity];
+          for(int pullCount = 0; pullCount < hardPity; pullCount++)
+            to[pullCount] += from[pullCount];
+        }
+      }
+    }
+  }
+  state.pityCount = hardPity;
+  state.probabilities.swap(carried);
+  state.fatePoints = 0;
+
+  GNSN_TimelineResult phaseResult;
+  phaseResult.probability = reached[0] + reached[1];
+  phaseResult.allProbability = reached[1] * this->GetOnTrack(this->banners[weapon ? GNSN_TimelineCharacter : GNSN_TimelineWeapon]);
+  phaseResult.expectedPulls = expectedPulls;
+  this->results.push_back(phaseResult);
+  if(result)
+    *result = phaseResult;
+  return true;
+}
+
+double GNSN_Timeline::GetStateProbability(GNSN_TimelineBanner banner, int pity, bool guaranteed) const
+{
+  const BannerState& state = this->banners[banner];
+  if(pity < 0 || pity >= state.pityCount)
+    return 0.0;
+  const int guarantee = guaranteed ? 1 : 0;
+  return state.probabilities[(size_t)guarantee * state.pityCount + pity] + state.probabilities[(size_t)(2 + guarantee) * state.pityCount + pity];
+}
+
+void GNSN_Timeline::Write(std::ostream& os, int digits) const
+{
+  os << std::fixed << std::setprecision(digits);
+  for(size_t phase = 0; phase < this->results.size(); phase++)
+    os << phase + 1 << "\t" << this->results[phase].probability << "\t" << this->results[phase].allProbability << "\t" << this->results[phase].expectedPulls << "\n";
+}
+
+const std::vector<double>& GNSN_Timeline::GetRates(const GNSN_PityRules& pity)
+{
+  for(const SourceRates& source : this->sources)
+  {
+    if(source.pity == pity)
+      return source.rates;
+  }
+
+  // The same rates as "ProbSrc_SSR...".
+  SourceRates source;
+  source.pity = pity;
+  source.rates.resize(pity.hardPity);
+  for(int pullCount = 0; pullCount < pity.hardPity; pullCount++)
+  {
+    double rate = pity.baseRate.ToDouble();
+    if(pullCount == pity.hardPity - 1)
+      rate = 1.0;
+    else if(pullCount > pity.softPity)
+      rate = (double)(pullCount - pity.softPity) * pity.softPityIncrement.ToDouble() + rate;
+    source.rates[pullCount] = std::min(rate, 1.0);
+  }
+  this->sources.push_back(source);
+  return this->sources.back().rates;
+}
+
+double GNSN_Timeline::GetOnTrack(const BannerState& state) const
+{
+  double onTrack = 0.0;
+  for(size_t index = (size_t)2 * state.pityCount; index < state.probabilities.size(); index++)
+    onTrack += state.probabilities[index];
+  return onTrack;
+}
\ No newline at end of file
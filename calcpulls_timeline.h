@@ -0,0 +1,96 @@
+#pragma once
+#include <ostream>
+#include <vector>
+
+#include "calcpulls.h"
+
+// ---- #
+// Timeline of banner phases.
+// Each phase is a banner (character or weapon) with its own rules, a target of copies and a budget of pulls for it.
+// Pulling stops at the target or when the budget runs out, and the pity and the guarantee carry over
+// --- to the next phase on the same banner, like they do in the game from one patch to the next.
+// Fate points don't carry over (the game resets them when a weapon banner ends), and neither do unspent pulls.
+//
+// The phases are added one at a time, and each gets its answer right away (streaming):
+// --- the chance to reach its target, and the chance to have reached every target so far.
+// Between phases, each banner keeps the distribution of its state, one probability per pity, guarantee,
+// --- and whether every phase of that banner so far reached its target: 2 * 2 * hard pity values, whatever the phases were.
+// A phase steps that forward one pull at a time over the copies and fate points it's going through,
+// --- by the chance of a five-star on each pull count (the same rates as "ProbSrc_SSR..." of the calculator),
+// --- and the copies and fate points are summed out again when the phase ends, so nothing grows from phase to phase.
+// The banners are pulled on independently, so the chance to have reached every target is the product of theirs.
+// Everything is in doubles, rules with the same pity share their rates, and a phase costs about
+// --- pulls * copies * (fate points + 1) * 4 * hard pity multiplications.
+// ---- #
+
+enum GNSN_TimelineBanner
+{
+  GNSN_TimelineCharacter = 0,
+  GNSN_TimelineWeapon = 1,
+};
+
+struct GNSN_TimelinePhase
+{
+  GNSN_TimelineBanner banner = GNSN_TimelineCharacter;
+  int copies = 1;                              // Copies of the featured character, or of the specific weapon, to stop at.
+  int pulls = 0;                               // The budget of this phase.
+  GNSN_BannerRules rules = GNSN_GenshinRules; // Only the part for "banner" is used.
+};
+
+struct GNSN_TimelineResult
+{
+  double probability = 0.0;    // Chance to reach the target of this phase.
+  double allProbability = 0.0; // Chance to have reached the targets of this phase and every one before it, on both banners.
+  double expectedPulls = 0.0;  // Pulls this phase takes on average, up to its budget.
+};
+
+class GNSN_Timeline
+{
+private:
+  // Distribution of a banner's state between phases, indexed by "(onTrack * 2 + guaranteed) * pityCount + pity",
+  // --- where "onTrack" is whether every phase of the banner so far reached its target.
+  struct BannerState
+  {
+    int pityCount = 0;  // The hard pity of the last phase, or past the starting pity before any.
+    std::vector<double> probabilities;
+    int fatePoints = 0; // For the next phase only, from the starting state.
+  };
+
+  // The chance of a five-star per pull count, per pity rules seen so far.
+  struct SourceRates
+  {
+    GNSN_PityRules pity;
+    std::vector<double> rates;
+  };
+
+  BannerState banners[2];
+  std::vector<SourceRates> sources;
+  std::vector<GNSN_TimelineResult> results;
+
+public:
+  // Starts from zero pity on both banners.
+  GNSN_Timeline();
+
+  // Forget the phases, and start from these states, with every target so far reached.
+  // Returns false, leaving the timeline as it was, for a pity or fate points below 0.
+  // A pity at or past the hard pity of the next phase's rules means the next pull is a five-star,
+  // --- and fate points at or past its rules' mean the next five-star is the specific one.
+  bool Reset(const GNSN_PullState& characterState, const GNSN_PullState& weaponState);
+
+  // Step through a phase and give its result (also kept for "GetResults()" and "Write()").
+  // Returns false, leaving the timeline as it was, for fewer than one copy, a budget below 0 or rules that don't validate.
+  bool AddPhase(const GNSN_TimelinePhase& phase, GNSN_TimelineResult* result = nullptr);
+
+  const std::vector<GNSN_TimelineResult>& GetResults() const { return results; }
+
+  // Chance that a banner's next phase starts from this pity and guarantee (with every target so far reached or not).
+  double GetStateProbability(GNSN_TimelineBanner banner, int pity, bool guaranteed) const;
+
+  // The results, one line per phase: the phase number, the probability, the probability of every phase so far
+  // --- and the expected pulls, tab separated.
+  void Write(std::ostream& os, int digits = 12) const;
+
+private:
+  const std::vector<double>& GetRates(const GNSN_PityRules& pity);
+  double GetOnTrack(const BannerState& state) const;
+};
\ No newline at end of file
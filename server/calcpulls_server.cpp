@@ -0,0 +1,113 @@
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <mpir.h>
+
+#include "../calcpulls_query.h"
+
+// ---- #
+// Query server executable.
+// Calculates the tables once (or maps them in from a table file), then answers queries on a Unix domain socket
+// --- (see "calcpulls_query.h" for the protocol) until it gets SIGINT or SIGTERM.
+//
+// Usage: calcpulls_server [--socket calcpulls.sock] [--workers 0] [--threads 0] [--rules file] [--tables file] [--digits 24]
+// "--workers" is the size of the pool answering queries, and "--threads" the threads calculating the tables,
+// --- where 0 means one per hardware thread for either.
+// "--tables" loads the tables from that file if it has them for these rules, and otherwise calculates them and saves them there.
+// ---- #
+
+typedef std::chrono::steady_clock ServerClock;
+
+struct ServerOptions
+{
+  std::string socket = "calcpulls.sock";
+  int workers = 0;
+  int threads = 0;
+  std::string rules;
+  std::string tables;
+  int digits = 0;
+};
+
+int main(int argc, char** argv)
+{
+  ServerOptions options;
+  for(int arg = 1; arg < argc; arg++)
+  {
+    const bool hasValue = arg + 1 < argc;
+    if(std::strcmp(argv[arg], "--socket") == 0 && hasValue)
+      options.socket = argv[++arg];
+    else if(std::strcmp(argv[arg], "--workers") == 0 && hasValue)
+      options.workers = std::max(0, std::atoi(argv[++arg]));
+    else if(std::strcmp(argv[arg], "--threads") == 0 && hasValue)
+      options.threads = std::max(0, std::atoi(argv[++arg]));
+    else if(std::strcmp(argv[arg], "--rules") == 0 && hasValue)
+      options.rules = argv[++arg];
+    else if(std::strcmp(argv[arg], "--tables") == 0 && hasValue)
+      options.tables = argv[++arg];
+    else if(std::strcmp(argv[arg], "--digits") == 0 && hasValue)
+      options.digits = std::max(0, std::atoi(argv[++arg]));
+    else
+    {
+      std::cerr << "Usage: " << argv[0] << " [--socket calcpulls.sock] [--workers 0] [--threads 0] [--rules file] [--tables file] [--digits 24]\n";
+      return 1;
+    }
+  }
+
+  // Every thread started from here on leaves these signals to "sigwait()" below.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+  std::signal(SIGPIPE, SIG_IGN);
+
+  GNSN_WProbCalc calc;
+  calc.SetThreadCount(options.threads);
+  if(!options.rules.empty())
+  {
+    GNSN_BannerRules rules = calc.GetBannerRules();
+    std::string error;
+    if(!rules.LoadFile(options.rules.c_str(), &error) || !calc.SetBannerRules(rules))
+    {
+      std::cerr << "Bad rules in \"" << options.rules << "\": " << error << "\n";
+      return 1;
+    }
+  }
+  if(options.digits > 0)
+    calc.SetAdaptivePrecision(options.digits);
+
+  const ServerClock::time_point start = ServerClock::now();
+  bool loaded = false;
+  if(!options.tables.empty())
+    loaded = calc.LoadTables(options.tables.c_str());
+
+  GNSN_QueryTables tables;
+  tables.Build(calc);
+  if(!options.tables.empty() && !loaded && !calc.SaveTables(options.tables.c_str()))
+    std::cerr << "Couldn't save the tables to \"" << options.tables << "\".\n";
+  std::cerr << (loaded ? "Loaded" : "Calculated") << " the tables in "
+    << std::chrono::duration<double>(ServerClock::now() - start).count() << " s.\n";
+
+  // The queries only need the doubles from here on.
+  calc.Clean();
+
+  GNSN_QueryServer server(tables);
+  std::string error;
+  if(!server.Start(options.socket.c_str(), options.workers, &error))
+  {
+    std::cerr << "Couldn't start the server: " << error << "\n";
+    return 1;
+  }
+  std::cerr << "Listening on \"" << options.socket << "\".\n";
+
+  int received = 0;
+  sigwait(&signals, &received);
+
+  server.Stop();
+  std::cerr << "Answered " << server.GetQueryCount() << " queries in " << server.GetFrameCount() << " frames.\n";
+  return 0;
+}
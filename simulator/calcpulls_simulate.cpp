@@ -0,0 +1,85 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <mpir.h>
+
+#include "../calcpulls_simulate.h"
+
+// ---- #
+// Simulator executable.
+// Simulates the banners and checks every table of the calculator against the trials, writing the report as JSON.
+// Exits with 2 when a table is off by more than the confidence allows.
+//
+// Usage: calcpulls_simulate [--trials 1000000] [--seed 1] [--threads 0] [--rules file] [--z 3.29] [--json file]
+// A thread count of 0 means one per hardware thread.
+// ---- #
+
+struct SimulateOptions
+{
+  uint64_t trials = 1000000;
+  uint64_t seed = 1;
+  int threads = 0;
+  std::string rules;
+  double z = 3.29;
+  std::string json;
+};
+
+int main(int argc, char** argv)
+{
+  SimulateOptions options;
+  for(int arg = 1; arg < argc; arg++)
+  {
+    const bool hasValue = arg + 1 < argc;
+    if(std::strcmp(argv[arg], "--trials") == 0 && hasValue)
+      options.trials = std::strtoull(argv[++arg], nullptr, 10);
+    else if(std::strcmp(argv[arg], "--seed") == 0 && hasValue)
+      options.seed = std::strtoull(argv[++arg], nullptr, 10);
+    else if(std::strcmp(argv[arg], "--threads") == 0 && hasValue)
+      options.threads = std::max(0, std::atoi(argv[++arg]));
+    else if(std::strcmp(argv[arg], "--rules") == 0 && hasValue)
+      options.rules = argv[++arg];
+    else if(std::strcmp(argv[arg], "--z") == 0 && hasValue)
+      options.z = std::atof(argv[++arg]);
+    else if(std::strcmp(argv[arg], "--json") == 0 && hasValue)
+      options.json = argv[++arg];
+    else
+    {
+      std::cerr << "Usage: " << argv[0] << " [--trials 1000000] [--seed 1] [--threads 0] [--rules file] [--z 3.29] [--json file]\n";
+      return 1;
+    }
+  }
+
+  GNSN_BannerRules rules = GNSN_GenshinRules;
+  if(!options.rules.empty())
+  {
+    std::string error;
+    if(!rules.LoadFile(options.rules.c_str(), &error))
+    {
+      std::cerr << "Bad rules in \"" << options.rules << "\": " << error << "\n";
+      return 1;
+    }
+  }
+
+  GNSN_WProbCalc calc;
+  calc.SetThreadCount(options.threads);
+  calc.SetBannerRules(rules);
+
+  GNSN_Simulator simulator(rules);
+  simulator.Run(options.trials, options.seed, options.threads);
+
+  GNSN_SimulationReport report;
+  simulator.Compare(calc, options.z, report);
+  if(options.json.empty())
+  {
+    std::cout << report.ToJSON();
+  }
+  else
+  {
+    std::ofstream ofs(options.json, std::ofstream::out | std::ofstream::trunc);
+    ofs << report.ToJSON();
+  }
+  return report.Passed() ? 0 : 2;
+}